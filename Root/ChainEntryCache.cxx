@@ -0,0 +1,143 @@
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+#include "TFile.h"
+#include "TSystem.h"
+
+#include "SusyCommon/ChainEntryCache.h"
+#include "SusyCommon/SusyAtomicFile.h"
+#include "SusyNtuple/ChainHelper.h"
+
+using namespace std;
+
+/*--------------------------------------------------------------------------------*/
+// ChainEntryCache Constructor, reads the cache file if it exists
+/*--------------------------------------------------------------------------------*/
+ChainEntryCache::ChainEntryCache(string cacheFile) :
+        m_cacheFile(cacheFile),
+        m_changed(false),
+        m_nHits(0),
+        m_nMiss(0),
+        m_nEmpty(0)
+{
+  ifstream in(m_cacheFile.c_str());
+  string line;
+  while(getline(in, line)){
+    stringstream stream(line);
+    string path, treeName;
+    FileInfo info;
+    if(stream >> path >> treeName >> info.size >> info.mtime >> info.entries)
+      m_files[path + " " + treeName] = info;
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+// Add a root file or a file list
+/*--------------------------------------------------------------------------------*/
+int ChainEntryCache::addFileList(TChain* chain, string fileList)
+{
+  if(fileList.size() > 5 && fileList.substr(fileList.size()-5) == ".root")
+    return addFile(chain, fileList);
+
+  ifstream in(fileList.c_str());
+  if(!in.is_open()){
+    cout << "ChainEntryCache::addFileList ERROR - cannot open file list " << fileList << endl;
+    return 1;
+  }
+  string line;
+  while(getline(in, line)){
+    size_t first = line.find_first_not_of(" \t\r");
+    if(first == string::npos || line[first] == '#') continue;
+    size_t last = line.find_last_not_of(" \t\r");
+    if(addFile(chain, line.substr(first, last-first+1))) return 1;
+  }
+  cout << "ChainEntryCache : " << m_nHits << " files from cache, "
+       << m_nMiss << " files counted, " << m_nEmpty << " empty files skipped" << endl;
+  return 0;
+}
+/*--------------------------------------------------------------------------------*/
+int ChainEntryCache::addFile(TChain* chain, string fileName)
+{
+  // Remote files can not be checked, let the chain handle them
+  FileStat_t stat;
+  if(gSystem->GetPathInfo(fileName.c_str(), stat) != 0){
+    chain->Add(fileName.c_str());
+    return 0;
+  }
+
+  string key = fileName + " " + chain->GetName();
+  map<string, FileInfo>::iterator it = m_files.find(key);
+  if(it != m_files.end() && it->second.size == stat.fSize && it->second.mtime == stat.fMtime){
+    m_nHits++;
+    addCounted(chain, fileName, it->second.entries);
+    return 0;
+  }
+
+  // Count the entries once
+  TFile* file = TFile::Open(fileName.c_str());
+  TTree* tree = file? (TTree*) file->Get(chain->GetName()) : 0;
+  if(tree == 0){
+    cout << "ChainEntryCache::addFile ERROR - no tree " << chain->GetName()
+         << " in " << fileName << endl;
+    if(file) file->Close();
+    delete file;
+    return 1;
+  }
+  FileInfo info;
+  info.size    = stat.fSize;
+  info.mtime   = stat.fMtime;
+  info.entries = tree->GetEntries();
+  file->Close();
+  delete file;
+
+  m_files[key] = info;
+  m_changed = true;
+  m_nMiss++;
+  addCounted(chain, fileName, info.entries);
+  return 0;
+}
+/*--------------------------------------------------------------------------------*/
+void ChainEntryCache::addCounted(TChain* chain, string fileName, Long64_t entries)
+{
+  // TChain::Add takes 0 entries as "unknown" and opens the file to count them,
+  // empty files add nothing to the chain so they are skipped
+  if(entries > 0) chain->Add(fileName.c_str(), entries);
+  else m_nEmpty++;
+}
+
+/*--------------------------------------------------------------------------------*/
+// Save the cache, see SusyAtomicFile for how concurrent jobs are handled
+/*--------------------------------------------------------------------------------*/
+int ChainEntryCache::save()
+{
+  if(!m_changed) return 0;
+
+  SusyAtomicFile file(m_cacheFile);
+  if(!file.isOpen()){
+    cout << "ChainEntryCache::save ERROR - cannot write " << file.tmpName() << endl;
+    return 1;
+  }
+  ofstream& out = file.stream();
+  for(map<string, FileInfo>::const_iterator it = m_files.begin(); it != m_files.end(); ++it){
+    out << it->first << " " << it->second.size << " " << it->second.mtime << " "
+        << it->second.entries << endl;
+  }
+  if(file.commit()){
+    cout << "ChainEntryCache::save ERROR - cannot write " << m_cacheFile << endl;
+    return 1;
+  }
+  m_changed = false;
+  return 0;
+}
+
+/*--------------------------------------------------------------------------------*/
+int ChainEntryCache::addFileList(TChain* chain, string fileList, string cacheFile)
+{
+  if(cacheFile == "") return ChainHelper::addFileList(chain, fileList);
+
+  ChainEntryCache cache(cacheFile);
+  int err = cache.addFileList(chain, fileList);
+  if(err) return err;
+  return cache.save();
+}
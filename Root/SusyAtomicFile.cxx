@@ -0,0 +1,43 @@
+#include <sstream>
+
+#include "TSystem.h"
+
+#include "SusyCommon/SusyAtomicFile.h"
+
+using namespace std;
+
+/*--------------------------------------------------------------------------------*/
+// SusyAtomicFile Constructor, opens the temporary file
+/*--------------------------------------------------------------------------------*/
+SusyAtomicFile::SusyAtomicFile(string fileName, bool binary) :
+        m_fileName(fileName),
+        m_committed(false)
+{
+  stringstream tmpName;
+  tmpName << fileName << ".tmp" << gSystem->GetPid();
+  m_tmpName = tmpName.str();
+  m_out.open(m_tmpName.c_str(), binary? ios::out | ios::binary : ios::out);
+}
+/*--------------------------------------------------------------------------------*/
+SusyAtomicFile::~SusyAtomicFile()
+{
+  if(m_committed || !m_out.is_open()) return;
+  m_out.close();
+  gSystem->Unlink(m_tmpName.c_str());
+}
+
+/*--------------------------------------------------------------------------------*/
+// Rename the complete temporary file to the file name
+/*--------------------------------------------------------------------------------*/
+int SusyAtomicFile::commit()
+{
+  if(!m_out.is_open()) return 1;
+  m_out.close();
+  // A short write leaves a truncated file, whose last line may still parse
+  if(m_out.fail() || gSystem->Rename(m_tmpName.c_str(), m_fileName.c_str()) != 0){
+    gSystem->Unlink(m_tmpName.c_str());
+    return 1;
+  }
+  m_committed = true;
+  return 0;
+}
@@ -1,6 +1,10 @@
 #include <limits>
+#include <sstream>
 
 #include "TSystem.h"
+#include "TMutex.h"
+#include "TStopwatch.h"
+#include "TVector2.h"
 
 #include "SusyCommon/SusyD3PDAna.h"
 #include "MultiLep/ElectronTools.h"
@@ -19,6 +23,7 @@ using namespace std;
 
 #define GeV 1000.
 
+
 /*--------------------------------------------------------------------------------*/
 // SusyD3PDAna Constructor
 /*--------------------------------------------------------------------------------*/
@@ -27,6 +32,7 @@ SusyD3PDAna::SusyD3PDAna() :
         m_stream(Stream_Unknown),
         m_isAF2(false),
         m_mcProd(MCProd_Unknown),
+        m_isSusySample(false),
         m_d3pdTag(D3PD_p1328),
         m_selectPhotons(false),
         m_selectTaus(false),
@@ -35,6 +41,10 @@ SusyD3PDAna::SusyD3PDAna() :
         m_doMetMuCorr(false),
         m_doMetFix(false),
         //m_useMetMuons(false),
+        m_legacyOR(false),
+        m_validateOR(false),
+        m_fullSysReselection(false),
+        m_validateSysReselection(false),
         m_lumi(LUMI_A_E),
         m_sumw(1),
         m_xsec(-1),
@@ -42,17 +52,29 @@ SusyD3PDAna::SusyD3PDAna() :
         m_mcRun(0),
         m_mcLB(0),
         m_sys(false),
+        m_xsecChannel(-1),
+        m_xsecWeight(0),
+        m_hasTrig2mu8EFxe40(false),
+        m_hasTrigMu24j65EFxe40wMu(false),
+        m_hasMuTrig2mu8EFxe40(false),
+        m_hasMuTrigMu24j65EFxe40wMu(false),
+        m_hasMuTrigMu24tight(false),
+        m_hasMuTrigMu36tight(false),
         m_eleMediumSFTool(0),
-        m_pileup(0),
-        m_pileup_up(0),
-        m_pileup_dn(0),
-        m_pileupAB3(0),
-        m_pileupAB(0),
-        m_pileupAE(0),
+        m_pileupWeights(0),
         m_susyXsec(0),
-        m_hforTool()
+        m_hforTool(),
+        m_toolOwner(0),
+        m_toolKey(""),
+        m_keepTools(false),
+        m_toolMutex(0)
 {
   m_hforTool.setVerbosity(HforToolD3PD::ERROR);
+  m_progress.setName("SusyD3PDAna");
+  clearBatch();
+  m_memo.valid = 0;
+  for(int i=0; i<N_MEMO_ITEMS; i++) m_memo.hits[i] = m_memo.misses[i] = 0;
+  for(int c=0; c<SusyKinematics::N_COLLECTIONS; c++) m_calibSys[c] = NtSys_NOM;
 
   // Create the addition electron efficiency SF tool for medium SFs
   m_eleMediumSFTool = new Root::TElectronEfficiencyCorrectionTool;
@@ -67,7 +89,11 @@ SusyD3PDAna::SusyD3PDAna() :
 /*--------------------------------------------------------------------------------*/
 SusyD3PDAna::~SusyD3PDAna()
 {
-  if(m_eleMediumSFTool) delete m_eleMediumSFTool;
+  // Shared tools belong to the owner
+  if(m_toolOwner == 0){
+    if(m_eleMediumSFTool) delete m_eleMediumSFTool;
+    if(m_toolMutex) delete m_toolMutex;
+  }
   #ifdef USEPDFTOOL
   if(m_pdfTool) delete m_pdfTool;
   #endif
@@ -106,40 +132,123 @@ void SusyD3PDAna::Begin(TTree* /*tree*/)
 
   cout << "DataStream: " << streamName(m_stream) << endl;
 
-  // Setup SUSYTools
-  bool isMC12b = (m_mcProd == MCProd_MC12b);
-  bool useLeptonTrigger = false;
-  m_susyObj.initialize(!m_isMC, m_isAF2, isMC12b, useLeptonTrigger);
-                       //gSystem->ExpandPathName("$ROOTCOREBIN/data/MuonMomentumCorrections/"),
-                       //gSystem->ExpandPathName("$ROOTCOREBIN/data/MuonEfficiencyCorrections/"));
-                       //"STACO_CB_plus_ST",
-                       //"efficiencySF.offline.RecoTrk.2012.8TeV.rel17p2.v02.root",
-                       //"efficiencySF.offline.Tight.2012.8TeV.rel17p2.v02.root",
-                       //"efficiencySF.e24vhi_medium1_e60_medium1.Tight.2012.8TeV.rel17p2.v02.root",
-                       //gSystem->ExpandPathName("$ROOTCOREBIN/data/MultiLep"));
-                       
-  // Turn on jet calibration
-  m_susyObj.SetJetCalib(true);
+  // Tools are kept from the previous sample if they were setup for the same configuration
+  string toolKey = toolConfigKey();
+  if(toolKey == m_toolKey){
+    cout << "Reusing the tools of the previous sample" << endl;
+    return;
+  }
+  if(m_toolKey != ""){
+    releaseTools();
+    // The previous sample was read with another configuration, the cache
+    // learns its branches again and the branch profile starts over
+    resetBranchUsage();
+  }
 
-  // Initialize electron medium SF
-  // TODO: update this whenever it gets updated in SUSYTools!
-  string eleMedFile = "${ROOTCOREBIN}";
-  eleMedFile += "/data/ElectronEfficiencyCorrection/efficiencySF.offline.Medium.2012.8TeV.rel17p2.v07.root";
-  m_eleMediumSFTool->addFileName(eleMedFile.c_str());
-  if(!m_eleMediumSFTool->initialize()){
-    cout << "SusyD3PDAna::Begin : ERROR initializing TElectronEfficiencyCorrectionTool with file "
-         << eleMedFile << endl;
+  // SUSYTools and the fake met estimator belong to each selector,
+  // the read-only tools are possibly shared with other selectors
+  vector<int> tools;
+  tools.push_back(INIT_SUSYOBJ);
+  tools.push_back(INIT_FAKEMET);
+  if(m_toolOwner) useOwnerTools();
+  else getSharedTools(tools);
+  initTools(tools);
+
+  m_toolKey = toolKey;
+}
+
+/*--------------------------------------------------------------------------------*/
+// Initialize the tools which are only read during the event loop:
+// electron medium SF, cross section db, GRL and pileup reweighting.
+/*--------------------------------------------------------------------------------*/
+void SusyD3PDAna::initSharedTools()
+{
+  vector<int> tools;
+  getSharedTools(tools);
+  initTools(tools);
+}
+/*--------------------------------------------------------------------------------*/
+void SusyD3PDAna::getSharedTools(vector<int>& tools)
+{
+  tools.push_back(INIT_ELESF);
+  if(m_isMC){
+    tools.push_back(INIT_XSEC);
+    tools.push_back(INIT_PILEUP);
+  }
+  else tools.push_back(INIT_GRL);
+}
+
+/*--------------------------------------------------------------------------------*/
+// Initialize the tools and report the time of each. All the tools are ready when
+// this returns, i.e. before the first event
+/*--------------------------------------------------------------------------------*/
+void SusyD3PDAna::initTools(const vector<int>& tools)
+{
+  static const char* toolNames[N_INIT_TOOLS] = {
+    "SUSYObjDef", "FakeMetEstimator", "electron medium SF", "SUSY cross sections",
+    "GRL", "pileup reweighting"
+  };
+
+  TStopwatch timer;
+  bool failed = false;
+  for(uint i=0; i<tools.size(); i++){
+    TStopwatch toolTimer;
+    int status = initTool(tools[i]);
+    cout << "SusyD3PDAna::initTools - " << toolNames[tools[i]]
+         << (status? " FAILED" : " initialized") << " in " << toolTimer.RealTime() << " s" << endl;
+    if(status) failed = true;
+  }
+  cout << "SusyD3PDAna::initTools - " << tools.size() << " tools initialized in "
+       << timer.RealTime() << " s" << endl;
+  if(failed){
+    cout << "SusyD3PDAna::initTools - ERROR in tool initialization. Aborting" << endl;
     abort();
   }
+}
+/*--------------------------------------------------------------------------------*/
+int SusyD3PDAna::initTool(int tool)
+{
+  // Setup SUSYTools
+  if(tool == INIT_SUSYOBJ){
+    bool isMC12b = (m_mcProd == MCProd_MC12b);
+    bool useLeptonTrigger = false;
+    m_susyObj.initialize(!m_isMC, m_isAF2, isMC12b, useLeptonTrigger);
+                         //gSystem->ExpandPathName("$ROOTCOREBIN/data/MuonMomentumCorrections/"),
+                         //gSystem->ExpandPathName("$ROOTCOREBIN/data/MuonEfficiencyCorrections/"));
+                         //"STACO_CB_plus_ST",
+                         //"efficiencySF.offline.RecoTrk.2012.8TeV.rel17p2.v02.root",
+                         //"efficiencySF.offline.Tight.2012.8TeV.rel17p2.v02.root",
+                         //"efficiencySF.e24vhi_medium1_e60_medium1.Tight.2012.8TeV.rel17p2.v02.root",
+                         //gSystem->ExpandPathName("$ROOTCOREBIN/data/MultiLep"));
+
+    // Turn on jet calibration
+    m_susyObj.SetJetCalib(true);
+
+    // Set the MissingEt flag for STVF
+    // This is now done automatically when you call SUSYObjDef::GetMET
+    //if(m_metFlavor.Contains("STVF")) m_susyObj.GetMETUtility()->configMissingET(true, true);
+  }
 
-  // Set the MissingEt flag for STVF
-  // This is now done automatically when you call SUSYObjDef::GetMET
-  //if(m_metFlavor.Contains("STVF")) m_susyObj.GetMETUtility()->configMissingET(true, true);
+  else if(tool == INIT_FAKEMET){
+    m_fakeMetEst.initialize("$ROOTCOREBIN/data/MultiLep/fest_periodF_v1.root");
+  }
 
-  m_fakeMetEst.initialize("$ROOTCOREBIN/data/MultiLep/fest_periodF_v1.root");
+  // Initialize electron medium SF
+  else if(tool == INIT_ELESF){
+    // TODO: update this whenever it gets updated in SUSYTools!
+    string eleMedFile = "${ROOTCOREBIN}";
+    eleMedFile += "/data/ElectronEfficiencyCorrection/efficiencySF.offline.Medium.2012.8TeV.rel17p2.v07.root";
+    if(m_eleMediumSFTool == 0) m_eleMediumSFTool = new Root::TElectronEfficiencyCorrectionTool;
+    m_eleMediumSFTool->addFileName(eleMedFile.c_str());
+    if(!m_eleMediumSFTool->initialize()){
+      cout << "SusyD3PDAna::Begin : ERROR initializing TElectronEfficiencyCorrectionTool with file "
+           << eleMedFile << endl;
+      return 1;
+    }
+  }
 
   // SUSY cross sections
-  if(m_isMC){
+  else if(tool == INIT_XSEC){
     // Back to using the SUSYTools file
     //string xsecFileName  = gSystem->ExpandPathName("$ROOTCOREBIN/data/MultiLep/susy_crosssections_8TeV_mod.txt");
     string xsecFileName  = gSystem->ExpandPathName("$ROOTCOREBIN/data/SUSYTools/susy_crosssections_8TeV.txt");
@@ -147,92 +256,105 @@ void SusyD3PDAna::Begin(TTree* /*tree*/)
   }
 
   // GRL
-  if(!m_isMC){
-    if(m_grlFileName.Length() == 0){
+  else if(tool == INIT_GRL){
+    // The default is not stored in m_grlFileName, which is part of the tool configuration key
+    TString grlFileName = m_grlFileName;
+    if(grlFileName.Length() == 0){
       string grlName = "$ROOTCOREBIN/data/MultiLep/";
       grlName += "data12_8TeV.periodAllYear_DetStatus-v61-pro14-02_DQDefects-00-01-00_PHYS_StandardGRL_All_Good.xml";
-      m_grlFileName = gSystem->ExpandPathName(grlName.c_str());
+      grlFileName = gSystem->ExpandPathName(grlName.c_str());
     }
-    
-    Root::TGoodRunsListReader* grlReader = new Root::TGoodRunsListReader();
-    grlReader->AddXMLFile(m_grlFileName);
-    if(!grlReader->Interpret()){
-      cout << "SusyD3PDAna::initialize - ERROR in GRL. Aborting" << endl;
-      abort();
+
+    // Read from the binary cache next to the XML, the XML is only parsed when it changed
+    if(m_grl.load(grlFileName.Data())){
+      cout << "SusyD3PDAna::initialize - ERROR in GRL" << endl;
+      return 1;
     }
-    m_grl = grlReader->GetMergedGoodRunsList();
-    delete grlReader;
   }
 
-  // Pileup reweighting
-  if(m_isMC){
-    m_pileup = new Root::TPileupReweighting("PileupReweighting");
-    m_pileup->SetDataScaleFactors(1/1.11);
-    //m_pileup->AddConfigFile("$ROOTCOREBIN/data/SUSYTools/MC12b_MyPRW.prw.root");
-    m_pileup->AddConfigFile("$ROOTCOREBIN/data/PileupReweighting/mc12ab_defaults.prw.root");
-    //m_pileup->AddLumiCalcFile("$ROOTCOREBIN/data/MultiLep/ilumicalc_histograms_EF_2e12Tvh_loose1_200842-215643_v2.root");
-    m_pileup->AddLumiCalcFile("$ROOTCOREBIN/data/MultiLep/ilumicalc_histograms_EF_2e12Tvh_loose1_200842-215643_grl_v61.root");
-    m_pileup->SetUnrepresentedDataAction(2);
-    int pileupError = m_pileup->Initialize();
-    if(pileupError){
-      cout << "Problem in pileup initialization.  pileupError = " << pileupError << endl;
-      abort();
-    }
-    m_pileup_up = new Root::TPileupReweighting("PileupReweighting");
-    m_pileup_up->SetDataScaleFactors(1/1.08);
-    m_pileup_up->AddConfigFile("$ROOTCOREBIN/data/PileupReweighting/mc12ab_defaults.prw.root");
-    m_pileup_up->AddLumiCalcFile("$ROOTCOREBIN/data/MultiLep/ilumicalc_histograms_EF_2e12Tvh_loose1_200842-215643_grl_v61.root");
-    m_pileup_up->SetUnrepresentedDataAction(2);
-    pileupError = m_pileup_up->Initialize();
-    if(pileupError){
-      cout << "Problem in pileup initialization.  pileupError = " << pileupError << endl;
-      abort();
-    }
-    m_pileup_dn = new Root::TPileupReweighting("PileupReweighting");
-    m_pileup_dn->SetDataScaleFactors(1/1.14);
-    m_pileup_dn->AddConfigFile("$ROOTCOREBIN/data/PileupReweighting/mc12ab_defaults.prw.root");
-    m_pileup_dn->AddLumiCalcFile("$ROOTCOREBIN/data/MultiLep/ilumicalc_histograms_EF_2e12Tvh_loose1_200842-215643_grl_v61.root");
-    m_pileup_dn->SetUnrepresentedDataAction(2);
-    pileupError = m_pileup_dn->Initialize();
-    if(pileupError){
-      cout << "Problem in pileup initialization.  pileupError = " << pileupError << endl;
-      abort();
-    }
+  // Pileup reweighting, all the variants in one engine
+  else if(tool == INIT_PILEUP){
+    m_pileupWeights = new SusyPileupWeights();
+    return m_pileupWeights->initialize();
+  }
 
-    // pileup reweighting for 2012 A-B3 only
-    m_pileupAB3 = new Root::TPileupReweighting("PileupReweightingAB3");
-    m_pileupAB3->SetDataScaleFactors(1/1.11);
-    m_pileupAB3->AddConfigFile("$ROOTCOREBIN/data/PileupReweighting/mc12ab_defaults.prw.root");
-    m_pileupAB3->AddLumiCalcFile("$ROOTCOREBIN/data/MultiLep/ilumicalc_histograms_EF_2e12Tvh_loose1_200841-203195.root");
-    m_pileupAB3->SetUnrepresentedDataAction(2);
-    pileupError = m_pileupAB3->Initialize();
-    if(pileupError){
-      cout << "Problem in pileup initialization.  pileupError = " << pileupError << endl;
-      abort();
-    }
-    // pileup reweighting for 2012 A-B only
-    m_pileupAB = new Root::TPileupReweighting("PileupReweightingAB");
-    m_pileupAB->SetDataScaleFactors(1/1.11);
-    m_pileupAB->AddConfigFile("$ROOTCOREBIN/data/PileupReweighting/mc12ab_defaults.prw.root");
-    m_pileupAB->AddLumiCalcFile("$ROOTCOREBIN/data/MultiLep/ilumicalc_histograms_EF_e24vhi_medium1_200841-205113.root");
-    m_pileupAB->SetUnrepresentedDataAction(2);
-    pileupError = m_pileupAB->Initialize();
-    if(pileupError){
-      cout << "Problem in pileup initialization.  pileupError = " << pileupError << endl;
-      abort();
-    }
-    // pileup reweighting for 2012 A-E only
-    m_pileupAE = new Root::TPileupReweighting("PileupReweightingAE");
-    m_pileupAE->SetDataScaleFactors(1/1.11);
-    m_pileupAE->AddConfigFile("$ROOTCOREBIN/data/PileupReweighting/mc12ab_defaults.prw.root");
-    m_pileupAE->AddLumiCalcFile("$ROOTCOREBIN/data/MultiLep/ilumicalc_histograms_EF_2e12Tvh_loose1_200841-210308.root");
-    m_pileupAE->SetUnrepresentedDataAction(2);
-    pileupError = m_pileupAE->Initialize();
-    if(pileupError){
-      cout << "Problem in pileup initialization.  pileupError = " << pileupError << endl;
-      abort();
-    }
+  return 0;
+}
+
+/*--------------------------------------------------------------------------------*/
+// Tool sharing between selectors processing the same sample in several threads.
+// Each selector keeps its own event state and SUSYObjDef, only the read-only tools
+// of the owner are used. Calls into them are serialized with the owner's mutex.
+/*--------------------------------------------------------------------------------*/
+void SusyD3PDAna::setToolOwner(SusyD3PDAna* owner)
+{
+  if(owner->m_toolMutex == 0) owner->m_toolMutex = new TMutex();
+  m_toolOwner = owner;
+  m_toolMutex = owner->m_toolMutex;
+}
+/*--------------------------------------------------------------------------------*/
+void SusyD3PDAna::useOwnerTools()
+{
+  if(m_dbg) cout << "SusyD3PDAna::useOwnerTools" << endl;
+  if(m_eleMediumSFTool && m_eleMediumSFTool != m_toolOwner->m_eleMediumSFTool)
+    delete m_eleMediumSFTool;
+  m_eleMediumSFTool = m_toolOwner->m_eleMediumSFTool;
+  m_susyXsec        = m_toolOwner->m_susyXsec;
+  m_grl             = m_toolOwner->m_grl;
+  m_pileupWeights   = m_toolOwner->m_pileupWeights;
+}
+
+/*--------------------------------------------------------------------------------*/
+// Per-file constants. The branch content and the MC channel do not change within
+// a file, so they are resolved here instead of for every event
+/*--------------------------------------------------------------------------------*/
+Bool_t SusyD3PDAna::Notify()
+{
+  SusyD3PDInterface::Notify();
+  if(!m_tree || !m_tree->GetTree()) return kTRUE;
+
+  // The channel number is only read with the first event, see getXsecWeight
+  m_xsecChannel = -1;
+
+  m_isSusySample = d3pd.evt.SUSY_Spart1_pdgId.IsAvailable() &&
+                   d3pd.evt.SUSY_Spart2_pdgId.IsAvailable();
+
+  m_hasTrig2mu8EFxe40         = d3pd.trig.EF_2mu8_EFxe40_tclcw.IsAvailable();
+  m_hasTrigMu24j65EFxe40wMu   = d3pd.trig.EF_mu24_j65_a4tchad_EFxe40wMu_tclcw.IsAvailable();
+  m_hasMuTrig2mu8EFxe40       = d3pd.trig.trig_EF_trigmuonef_EF_2mu8_EFxe40_tclcw.IsAvailable();
+  m_hasMuTrigMu24j65EFxe40wMu = d3pd.trig.trig_EF_trigmuonef_EF_mu24_j65_a4tchad_EFxe40wMu_tclcw.IsAvailable();
+  m_hasMuTrigMu24tight        = d3pd.trig.trig_EF_trigmuonef_EF_mu24_tight.IsAvailable();
+  m_hasMuTrigMu36tight        = d3pd.trig.trig_EF_trigmuonef_EF_mu36_tight.IsAvailable();
+
+  if(m_dbg) cout << "SusyD3PDAna::Notify - susy sample " << m_isSusySample << endl;
+  return kTRUE;
+}
+
+/*--------------------------------------------------------------------------------*/
+// Branch manifest configuration
+/*--------------------------------------------------------------------------------*/
+string SusyD3PDAna::branchConfig()
+{
+  stringstream config;
+  config << SusyD3PDInterface::branchConfig() << " sys=" << (m_isMC && m_sys)
+         << " truth=" << m_selectTruth << " taus=" << m_selectTaus << " photons=" << m_selectPhotons;
+  return config.str();
+}
+
+/*--------------------------------------------------------------------------------*/
+// New entry, the memoized quantities are recomputed on their first use
+/*--------------------------------------------------------------------------------*/
+Int_t SusyD3PDAna::GetEntry(Long64_t e, Int_t getall)
+{
+  Int_t ret = SusyD3PDInterface::GetEntry(e, getall);
+  m_memo.valid = 0;
+  // The vertex count of a batch entry is already known
+  int iBatch = batchIndex();
+  if(iBatch >= 0){
+    m_memo.nGoodVtx = m_batch.nGoodVtx[iBatch];
+    memoSet(MEMO_NGOODVTX);
   }
+  return ret;
 }
 
 /*--------------------------------------------------------------------------------*/
@@ -243,11 +365,10 @@ Bool_t SusyD3PDAna::Process(Long64_t entry)
   // Communicate the entry number to the interface objects
   GetEntry(entry);
 
-  static Long64_t chainEntry = -1;
-  chainEntry++;
-  if(m_dbg || chainEntry%10000==0)
+  m_progress.count();
+  if(m_dbg)
   {
-    cout << "**** Processing entry " << setw(6) << chainEntry
+    cout << "**** Processing entry " << setw(6) << m_progress.entries()
          << " run " << setw(6) << d3pd.evt.RunNumber()
          << " event " << setw(7) << d3pd.evt.EventNumber() << " ****" << endl;
   }
@@ -258,9 +379,82 @@ Bool_t SusyD3PDAna::Process(Long64_t entry)
   selectObjects();
   buildMet();
 
+  endEntry();
   return kTRUE;
 }
 
+/*--------------------------------------------------------------------------------*/
+// Process a block of entries with the event level quantities filled beforehand
+/*--------------------------------------------------------------------------------*/
+Long64_t SusyD3PDAna::ProcessBatch(Long64_t firstEntry, Long64_t nEntries)
+{
+  fillBatch(firstEntry, nEntries);
+  Long64_t nProcessed = SusyD3PDInterface::ProcessBatch(firstEntry, nEntries);
+  clearBatch();
+  return nProcessed;
+}
+
+/*--------------------------------------------------------------------------------*/
+// Fill the event level quantities of a block of entries, stage by stage
+/*--------------------------------------------------------------------------------*/
+void SusyD3PDAna::fillBatch(Long64_t firstEntry, Long64_t nEntries)
+{
+  if(m_dbg>=5) cout << "fillBatch " << firstEntry << " " << nEntries << endl;
+
+  // The per-event methods below must compute the values, not read the batch
+  clearBatch();
+  m_batch.cutFlags.assign(nEntries, 0);
+  m_batch.nGoodVtx.assign(nEntries, 0);
+  m_batch.trigFlags.assign(nEntries, 0);
+  m_batch.genWeight.assign(nEntries, 1);
+
+  // Event info cleaning
+  for(Long64_t i=0; i<nEntries; i++){
+    GetEntry(firstEntry + i);
+    m_cutFlags = 0;
+    checkEventInfoCleaning();
+    m_batch.cutFlags[i] = m_cutFlags;
+  }
+
+  // Entries dropped by the event info cleaning never read the later stages
+  const uint infoCuts = ECut_GRL | ECut_LarErr | ECut_TileErr | ECut_TTC;
+  vector<bool> pass(nEntries, true);
+  if(filterEventInfo()){
+    for(Long64_t i=0; i<nEntries; i++) pass[i] = (m_batch.cutFlags[i] & infoCuts) == infoCuts;
+  }
+
+  // Vertices
+  for(Long64_t i=0; i<nEntries; i++){
+    if(!pass[i]) continue;
+    GetEntry(firstEntry + i);
+    m_cutFlags = 0;
+    checkVertexCleaning();
+    m_batch.cutFlags[i] |= m_cutFlags;
+    m_batch.nGoodVtx[i] = getNumGoodVtx();
+  }
+
+  // Trigger decisions
+  for(Long64_t i=0; i<nEntries; i++){
+    if(!pass[i]) continue;
+    GetEntry(firstEntry + i);
+    fillEventTriggers();
+    m_batch.trigFlags[i] = m_evtTrigFlags;
+  }
+
+  // Generator weights
+  if(m_isMC){
+    for(Long64_t i=0; i<nEntries; i++){
+      GetEntry(firstEntry + i);
+      m_batch.genWeight[i] = d3pd.truth.event_weight();
+    }
+  }
+
+  m_cutFlags = 0;
+  m_evtTrigFlags = 0;
+  m_batch.first = firstEntry;
+  m_batch.n = nEntries;
+}
+
 /*--------------------------------------------------------------------------------*/
 // The Terminate() function is the last function to be called during
 // a query. It always runs on the client, it can be used to present
@@ -268,24 +462,52 @@ Bool_t SusyD3PDAna::Process(Long64_t entry)
 /*--------------------------------------------------------------------------------*/
 void SusyD3PDAna::Terminate()
 {
+  SusyD3PDInterface::Terminate();
   if(m_dbg) cout << "SusyD3PDAna::Terminate" << endl;
+  if(m_dbg) printMemoStats();
+
+  if(!m_keepTools) releaseTools();
+}
+
+/*--------------------------------------------------------------------------------*/
+// Tool configuration key, the tools setup in Begin only depend on these settings
+/*--------------------------------------------------------------------------------*/
+string SusyD3PDAna::toolConfigKey()
+{
+  stringstream key;
+  key << "isMC=" << m_isMC << " isAF2=" << m_isAF2 << " mcProd=" << m_mcProd
+      << " d3pdTag=" << m_d3pdTag << " grl=" << m_grlFileName;
+  return key.str();
+}
+/*--------------------------------------------------------------------------------*/
+// Finalize and delete the tools, the next Begin sets them up again
+/*--------------------------------------------------------------------------------*/
+void SusyD3PDAna::releaseTools()
+{
+  if(m_dbg) cout << "SusyD3PDAna::releaseTools" << endl;
   m_susyObj.finalize();
 
-  if(m_isMC){
+  // The tools of a previous MC or data sample may be set, so delete all of them
+  if(m_toolOwner == 0){
     delete m_susyXsec;
-    delete m_pileup;
-    delete m_pileup_up;
-    delete m_pileup_dn;
-    delete m_pileupAB3;
-    delete m_pileupAB;
-    delete m_pileupAE;
+    if(m_pileupWeights) m_pileupWeights->printStats();
+    delete m_pileupWeights;
+    // The SF tool can only be initialized once, initSharedTools makes a new one
+    delete m_eleMediumSFTool;
   }
+  m_eleMediumSFTool = 0;
+  m_susyXsec  = 0;
+  m_pileupWeights = 0;
+  m_xsecMap.clear();
+  m_xsecChannel = -1;
+  m_grl.clear();
+  m_toolKey = "";
 }
 
 /*--------------------------------------------------------------------------------*/
 // Baseline object selection
 /*--------------------------------------------------------------------------------*/
-void SusyD3PDAna::selectBaselineObjects(SusyNtSys sys)
+void SusyD3PDAna::selectBaselineObjects(SusyNtSys sys, uint collections)
 {
   if(m_dbg>=5) cout << "selectBaselineObjects" << endl;
   vector<int> goodJets;  // What the hell is this??
@@ -320,37 +542,66 @@ void SusyD3PDAna::selectBaselineObjects(SusyNtSys sys)
   else if(sys == NtSys_TES_UP    ) susySys = SystErr::TESUP;      // TES up
   else if(sys == NtSys_TES_DN    ) susySys = SystErr::TESDOWN;    // TES down
 
+  bool doEle = (collections & (1u << SusyKinematics::ELE)) != 0;
+  bool doMuo = (collections & (1u << SusyKinematics::MUO)) != 0;
+  bool doJet = (collections & (1u << SusyKinematics::JET)) != 0;
+  bool doTau = (collections & (1u << SusyKinematics::TAU)) != 0 && m_selectTaus;
+
+  // One flag word per object
+  m_objs.resize(SusyKinematics::ELE, d3pd.ele.n());
+  m_objs.resize(SusyKinematics::MUO, d3pd.muo.n());
+  m_objs.resize(SusyKinematics::JET, d3pd.jet.n());
+  m_objs.resize(SusyKinematics::TAU, m_selectTaus? d3pd.tau.n() : 0);
+
   // Container object selection
-  if(m_selectTaus) m_contTaus = get_taus_baseline(&d3pd.tau, m_susyObj, 20.*GeV, 2.47,
-                                                  SUSYTau::TauNone, SUSYTau::TauNone, SUSYTau::TauNone,
-                                                  susySys, true);
+  if(doTau) m_objs.setObjects(SusyKinematics::TAU, SusyObjectFlags::OBJ_CONT,
+                              get_taus_baseline(&d3pd.tau, m_susyObj, 20.*GeV, 2.47,
+                                                SUSYTau::TauNone, SUSYTau::TauNone, SUSYTau::TauNone,
+                                                susySys, true));
 
   // Preselection
-  m_preElectrons = get_electrons_baseline(&d3pd.ele, !m_isMC, d3pd.evt.RunNumber(), m_susyObj, 
-                                          7.*GeV, 2.47, susySys);
-  m_preMuons = get_muons_baseline(&d3pd.muo, !m_isMC, m_susyObj, 
-                                  6.*GeV, 2.5, susySys);
+  if(doEle) m_objs.setObjects(SusyKinematics::ELE, SusyObjectFlags::OBJ_PRE,
+                              get_electrons_baseline(&d3pd.ele, !m_isMC, d3pd.evt.RunNumber(), m_susyObj, 
+                                                     7.*GeV, 2.47, susySys));
+  if(doMuo) m_objs.setObjects(SusyKinematics::MUO, SusyObjectFlags::OBJ_PRE,
+                              get_muons_baseline(&d3pd.muo, !m_isMC, m_susyObj, 
+                                                 6.*GeV, 2.5, susySys));
   // Removing eta cut for baseline jets. This is for the bad jet veto.
-  m_preJets = get_jet_baseline(&d3pd.jet, &d3pd.vtx, &d3pd.evt, !m_isMC, m_susyObj, 
-                               20.*GeV, std::numeric_limits<float>::max(), susySys, false, goodJets);
-  //m_preJets = get_jet_baseline(&d3pd.jet, &d3pd.vtx, &d3pd.evt, !m_isMC, m_susyObj, 
+  if(doJet) m_objs.setObjects(SusyKinematics::JET, SusyObjectFlags::OBJ_PRE,
+                              get_jet_baseline(&d3pd.jet, &d3pd.vtx, &d3pd.evt, !m_isMC, m_susyObj, 
+                                               20.*GeV, std::numeric_limits<float>::max(), susySys, false, goodJets));
+  //preJets() = get_jet_baseline(&d3pd.jet, &d3pd.vtx, &d3pd.evt, !m_isMC, m_susyObj, 
   //                             20.*GeV, 4.9, susySys, false, goodJets);
 
   // Selection for met muons
   // Diff with preMuons is pt selection
-  m_metMuons = get_muons_baseline(&d3pd.muo, !m_isMC, m_susyObj, 
-                                  10.*GeV, 2.5, susySys);
+  if(doMuo) m_objs.setObjects(SusyKinematics::MUO, SusyObjectFlags::OBJ_METMU,
+                              get_muons_baseline(&d3pd.muo, !m_isMC, m_susyObj, 
+                                                 10.*GeV, 2.5, susySys));
 
   // Preselect taus
-  if(m_selectTaus) m_preTaus = get_taus_baseline(&d3pd.tau, m_susyObj, 20.*GeV, 2.47, 
-                                                 SUSYTau::TauLoose, SUSYTau::TauLoose, SUSYTau::TauLoose, 
-                                                 susySys, true);
-  
+  if(doTau) m_objs.setObjects(SusyKinematics::TAU, SusyObjectFlags::OBJ_PRE,
+                              get_taus_baseline(&d3pd.tau, m_susyObj, 20.*GeV, 2.47, 
+                                                SUSYTau::TauLoose, SUSYTau::TauLoose, SUSYTau::TauLoose, 
+                                                susySys, true));
+
+  // The SUSYObjDef objects of these collections are now calibrated for sys,
+  // which leaves the collections it does not affect at nominal
+  uint affected = sysCollections(sys);
+  for(int c=SusyKinematics::ELE; c<=SusyKinematics::TAU; c++){
+    if(collections & (1u << c)) m_calibSys[c] = (affected & (1u << c))? sys : NtSys_NOM;
+  }
+
+  // Kinematics of the calibrated objects, read by everything downstream
+  fillKinematics(collections);
+
   performOverlapRemoval();
 
-  // combine leptons
-  m_preLeptons    = buildLeptonInfos(&d3pd.ele, m_preElectrons, &d3pd.muo, m_preMuons, m_susyObj);
-  m_baseLeptons   = buildLeptonInfos(&d3pd.ele, m_baseElectrons, &d3pd.muo, m_baseMuons, m_susyObj);
+  // combine leptons, buildLeptonInfos takes non-const lists
+  vector<int> preEle  = preElectrons(), preMuo = preMuons();
+  vector<int> baseEle = baseElectrons(), baseMuo = baseMuons();
+  m_preLeptons    = buildLeptonInfos(&d3pd.ele, preEle, &d3pd.muo, preMuo, m_susyObj);
+  m_baseLeptons   = buildLeptonInfos(&d3pd.ele, baseEle, &d3pd.muo, baseMuo, m_susyObj);
 }
 
 /*--------------------------------------------------------------------------------*/
@@ -358,43 +609,80 @@ void SusyD3PDAna::selectBaselineObjects(SusyNtSys sys)
 /*--------------------------------------------------------------------------------*/
 void SusyD3PDAna::performOverlapRemoval()
 {
+  if(m_legacyOR){
+    performOverlapRemovalLegacy();
+    return;
+  }
+
+  m_overlapRemoval.apply(m_kin, m_selectTaus, m_objs);
+
+  // Validation mode: compare every overlap removal to the legacy one
+  if(m_validateOR){
+    vector<int> baseEle = baseElectrons();
+    vector<int> baseMuo = baseMuons();
+    vector<int> baseJet = baseJets();
+    vector<int> baseTau = baseTaus();
+    performOverlapRemovalLegacy();
+    if(baseEle != baseElectrons() || baseMuo != baseMuons() ||
+       baseJet != baseJets() || baseTau != baseTaus()){
+      cout << "SusyD3PDAna::performOverlapRemoval ERROR - overlap removal differs from the legacy one"
+           << " in run " << d3pd.evt.RunNumber() << " event " << d3pd.evt.EventNumber()
+           << ": ele " << preElectrons().size() << " -> " << baseEle.size() << "/" << baseElectrons().size()
+           << " muo " << preMuons().size() << " -> " << baseMuo.size() << "/" << baseMuons().size()
+           << " jet " << preJets().size() << " -> " << baseJet.size() << "/" << baseJets().size()
+           << " tau " << preTaus().size() << " -> " << baseTau.size() << "/" << baseTaus().size() << endl;
+      abort();
+    }
+  }
+}
+/*--------------------------------------------------------------------------------*/
+void SusyD3PDAna::performOverlapRemovalLegacy()
+{
+  vector<int> baseEle, baseMuo, baseJet;
+  vector<int> baseTau = baseTaus();
+
   // e-e overlap removal
-  m_baseElectrons = overlap_removal(m_susyObj, &d3pd.ele, m_preElectrons, &d3pd.ele, m_preElectrons, 
-                                    0.05, true, true);
+  baseEle = overlap_removal(m_susyObj, &d3pd.ele, preElectrons(), &d3pd.ele, preElectrons(), 
+                            0.05, true, true);
   // jet-e overlap removal
-  m_baseJets      = overlap_removal(m_susyObj, &d3pd.jet, m_preJets, &d3pd.ele, m_baseElectrons, 
-                                    0.2, false, false);
+  baseJet = overlap_removal(m_susyObj, &d3pd.jet, preJets(), &d3pd.ele, baseEle, 
+                            0.2, false, false);
 
   if(m_selectTaus) {
     // tau-e overlap removal
-    m_baseTaus    = overlap_removal(m_susyObj, &d3pd.tau, m_preTaus, &d3pd.ele, m_baseElectrons, 0.2, false, false);
+    baseTau = overlap_removal(m_susyObj, &d3pd.tau, preTaus(), &d3pd.ele, baseEle, 0.2, false, false);
     // tau-mu overlap removal
-    m_baseTaus    = overlap_removal(m_susyObj, &d3pd.tau, m_baseTaus, &d3pd.muo, m_preMuons, 0.2, false, false);
+    baseTau = overlap_removal(m_susyObj, &d3pd.tau, baseTau, &d3pd.muo, preMuons(), 0.2, false, false);
   }
 
   // e-jet overlap removal
-  m_baseElectrons = overlap_removal(m_susyObj, &d3pd.ele, m_baseElectrons, &d3pd.jet, m_baseJets, 
-                                    0.4, false, false);
+  baseEle = overlap_removal(m_susyObj, &d3pd.ele, baseEle, &d3pd.jet, baseJet, 
+                            0.4, false, false);
 
   // m-jet overlap removal
-  m_baseMuons     = overlap_removal(m_susyObj, &d3pd.muo, m_preMuons, &d3pd.jet, m_baseJets, 0.4, false, false);
+  baseMuo = overlap_removal(m_susyObj, &d3pd.muo, preMuons(), &d3pd.jet, baseJet, 0.4, false, false);
 
   // e-m overlap removal
-  vector<int> copyElectrons = m_baseElectrons;
-  m_baseElectrons = overlap_removal(m_susyObj, &d3pd.ele, m_baseElectrons, &d3pd.muo, m_baseMuons, 
-                                    0.01, false, false);
-  m_baseMuons     = overlap_removal(m_susyObj, &d3pd.muo, m_baseMuons, &d3pd.ele, copyElectrons, 0.01, false, false);
+  vector<int> copyElectrons = baseEle;
+  baseEle = overlap_removal(m_susyObj, &d3pd.ele, baseEle, &d3pd.muo, baseMuo, 
+                            0.01, false, false);
+  baseMuo = overlap_removal(m_susyObj, &d3pd.muo, baseMuo, &d3pd.ele, copyElectrons, 0.01, false, false);
 
   // m-m overlap removal
-  m_baseMuons     = overlap_removal(m_susyObj, &d3pd.muo, m_baseMuons, &d3pd.muo, m_baseMuons, 0.05, true, false);
+  baseMuo = overlap_removal(m_susyObj, &d3pd.muo, baseMuo, &d3pd.muo, baseMuo, 0.05, true, false);
 
   // jet-tau overlap removal
-  m_baseJets      = overlap_removal(m_susyObj, &d3pd.jet, m_baseJets, &d3pd.tau, m_baseTaus, 0.2, false, false);
+  baseJet = overlap_removal(m_susyObj, &d3pd.jet, baseJet, &d3pd.tau, baseTau, 0.2, false, false);
 
   // remove SFOS lepton pairs with Mll < 12 GeV
-  m_baseElectrons = RemoveSFOSPair(m_susyObj, &d3pd.ele, m_baseElectrons, 12.*GeV);
-  m_baseMuons     = RemoveSFOSPair(m_susyObj, &d3pd.muo, m_baseMuons,     12.*GeV);
-  //m_baseTaus      = RemoveSFOSPair(m_susyObj, &d3pd.tau, m_baseTaus,      12.*GeV);
+  baseEle = RemoveSFOSPair(m_susyObj, &d3pd.ele, baseEle, 12.*GeV);
+  baseMuo = RemoveSFOSPair(m_susyObj, &d3pd.muo, baseMuo, 12.*GeV);
+  //baseTau = RemoveSFOSPair(m_susyObj, &d3pd.tau, baseTau, 12.*GeV);
+
+  m_objs.setObjects(SusyKinematics::ELE, SusyObjectFlags::OBJ_BASE, baseEle);
+  m_objs.setObjects(SusyKinematics::MUO, SusyObjectFlags::OBJ_BASE, baseMuo);
+  m_objs.setObjects(SusyKinematics::JET, SusyObjectFlags::OBJ_BASE, baseJet);
+  m_objs.setObjects(SusyKinematics::TAU, SusyObjectFlags::OBJ_BASE, baseTau);
 }
 
 /*--------------------------------------------------------------------------------*/
@@ -404,15 +692,20 @@ void SusyD3PDAna::selectSignalObjects()
 {
   if(m_dbg>=5) cout << "selectSignalObjects" << endl;
   uint nVtx = getNumGoodVtx();
-  m_sigElectrons = get_electrons_signal(&d3pd.ele, m_baseElectrons, &d3pd.muo, m_baseMuons,
-                                        nVtx, !m_isMC, m_susyObj, 10.*GeV, 0.16, 0.18, 5., 0.4);
-  m_sigMuons     = get_muons_signal(&d3pd.muo, m_baseMuons, &d3pd.ele, m_baseElectrons,
-                                    nVtx, !m_isMC, m_susyObj, 10.*GeV, .12, 3., 1.);
-  m_sigJets      = get_jet_signal(&d3pd.jet, m_susyObj, m_baseJets, 20.*GeV, 2.5, 0.75);
-  m_sigTaus      = get_taus_signal(&d3pd.tau, m_baseTaus, m_susyObj);
-
-  // combine light leptons
-  m_sigLeptons   = buildLeptonInfos(&d3pd.ele, m_sigElectrons, &d3pd.muo, m_sigMuons, m_susyObj);
+  m_objs.setObjects(SusyKinematics::ELE, SusyObjectFlags::OBJ_SIG,
+                    get_electrons_signal(&d3pd.ele, baseElectrons(), &d3pd.muo, baseMuons(),
+                                         nVtx, !m_isMC, m_susyObj, 10.*GeV, 0.16, 0.18, 5., 0.4));
+  m_objs.setObjects(SusyKinematics::MUO, SusyObjectFlags::OBJ_SIG,
+                    get_muons_signal(&d3pd.muo, baseMuons(), &d3pd.ele, baseElectrons(),
+                                     nVtx, !m_isMC, m_susyObj, 10.*GeV, .12, 3., 1.));
+  m_objs.setObjects(SusyKinematics::JET, SusyObjectFlags::OBJ_SIG,
+                    get_jet_signal(&d3pd.jet, m_susyObj, baseJets(), 20.*GeV, 2.5, 0.75));
+  m_objs.setObjects(SusyKinematics::TAU, SusyObjectFlags::OBJ_SIG,
+                    get_taus_signal(&d3pd.tau, baseTaus(), m_susyObj));
+
+  // combine light leptons, buildLeptonInfos takes non-const lists
+  vector<int> sigEle = sigElectrons(), sigMuo = sigMuons();
+  m_sigLeptons   = buildLeptonInfos(&d3pd.ele, sigEle, &d3pd.muo, sigMuo, m_susyObj);
 
   // photon selection done in separate method, why?
   if(m_selectPhotons) selectSignalPhotons();
@@ -442,14 +735,101 @@ void SusyD3PDAna::buildMet(SusyNtSys sys)
   vector<int> metElectrons = get_electrons_met(&d3pd.ele, m_susyObj);
 
   // Calculate the MET
-  // We use the metMuons instead of preMuons so that we can have a lower pt cut on preMuons
+  // We use the metMuons instead of preMuons so that we can have a lower pt cut on preMuons.
+  // GetMetVector takes non-const lists
+  vector<int> metMuo = metMuons(), baseEle = baseElectrons();
   TVector2 metVector = GetMetVector(m_susyObj, &d3pd.jet, &d3pd.muo, &d3pd.ele, &d3pd.met, 
-                                    &d3pd.evt, m_metMuons, m_baseElectrons, metElectrons, 
+                                    &d3pd.evt, metMuo, baseEle, metElectrons, 
                                     susySys, m_metFlavor, m_doMetMuCorr, m_doMetFix);
     
   m_met.SetPxPyPzE(metVector.X(), metVector.Y(), 0, metVector.Mod());
 }
 
+/*--------------------------------------------------------------------------------*/
+// Systematic dependencies
+/*--------------------------------------------------------------------------------*/
+uint SusyD3PDAna::sysCollections(SusyNtSys sys)
+{
+  if(isElecSys(sys)) return 1u << SusyKinematics::ELE;
+  if(isMuonSys(sys)) return 1u << SusyKinematics::MUO;
+  if(isJetSys(sys))  return 1u << SusyKinematics::JET;
+  if(isTauSys(sys))  return 1u << SusyKinematics::TAU;
+  // Soft term and weight systematics
+  return 0;
+}
+/*--------------------------------------------------------------------------------*/
+void SusyD3PDAna::reselectObjects(SusyNtSys sys)
+{
+  if(m_fullSysReselection){
+    m_susyObj.Reset();
+    clearObjects();
+    selectObjects(sys);
+    buildMet(sys);
+    return;
+  }
+
+  // Collections calibrated for another systematic than the one they need.
+  // No SUSYObjDef reset, the objects of the other collections keep their TLVs
+  uint affected = sysCollections(sys);
+  uint redo = 0;
+  for(int c=SusyKinematics::ELE; c<=SusyKinematics::TAU; c++){
+    if(c == SusyKinematics::TAU && !m_selectTaus) continue;
+    SusyNtSys calib = (affected & (1u << c))? sys : NtSys_NOM;
+    if(m_calibSys[c] != calib) redo |= 1u << c;
+  }
+
+  m_cutFlags = 0;
+  if(redo){
+    // Overlap removal, lepton infos and signal selection read all the collections
+    selectBaselineObjects(sys, redo);
+    selectSignalObjects();
+  }
+  buildMet(sys);
+
+  // Validation mode: compare every reselection to the full one
+  if(m_validateSysReselection){
+    vector<double> reselection, fullSelection;
+    getSelection(reselection);
+    m_susyObj.Reset();
+    clearObjects();
+    selectObjects(sys);
+    buildMet(sys);
+    getSelection(fullSelection);
+    if(reselection != fullSelection){
+      cout << "SusyD3PDAna::reselectObjects ERROR - selection of " << SusyNtSystNames[sys]
+           << " differs from the full reselection in run " << d3pd.evt.RunNumber()
+           << " event " << d3pd.evt.EventNumber() << ", recalibrated collections " << redo << endl;
+      abort();
+    }
+  }
+}
+/*--------------------------------------------------------------------------------*/
+void SusyD3PDAna::getSelection(vector<double>& selection)
+{
+  const SusyObjectFlags::ObjectFlag flags[5] = { SusyObjectFlags::OBJ_CONT, SusyObjectFlags::OBJ_PRE,
+                                                 SusyObjectFlags::OBJ_METMU, SusyObjectFlags::OBJ_BASE,
+                                                 SusyObjectFlags::OBJ_SIG };
+  selection.clear();
+  for(int c=SusyKinematics::ELE; c<=SusyKinematics::TAU; c++){
+    SusyKinematics::Collection coll = (SusyKinematics::Collection) c;
+    for(int f=0; f<5; f++){
+      const vector<int>& objects = m_objs.objects(coll, flags[f]);
+      selection.push_back(objects.size());
+      selection.insert(selection.end(), objects.begin(), objects.end());
+    }
+    for(uint i=0; i<m_kin.size(coll); i++){
+      if(!m_kin.isFilled(coll, i)) continue;
+      selection.push_back(i);
+      selection.push_back(m_kin.pt(coll, i));
+      selection.push_back(m_kin.eta(coll, i));
+      selection.push_back(m_kin.phi(coll, i));
+      selection.push_back(m_kin.e(coll, i));
+    }
+  }
+  selection.push_back(m_met.Px());
+  selection.push_back(m_met.Py());
+}
+
 /*--------------------------------------------------------------------------------*/
 // Signal photons
 /*--------------------------------------------------------------------------------*/
@@ -466,8 +846,13 @@ void SusyD3PDAna::selectSignalPhotons()
 
   // Latest and Greatest
   int nPV = getNumGoodVtx();
-  m_sigPhotons = get_photons_signal(&d3pd.pho, base_photons, m_susyObj, nPV, 
-                                    20.*GeV, etcone40CorrCut, isoType);
+  m_objs.resize(SusyKinematics::PHO, d3pd.pho.n());
+  m_objs.setObjects(SusyKinematics::PHO, SusyObjectFlags::OBJ_SIG,
+                    get_photons_signal(&d3pd.pho, base_photons, m_susyObj, nPV, 
+                                       20.*GeV, etcone40CorrCut, isoType));
+
+  m_kin.reset(SusyKinematics::PHO, d3pd.pho.n());
+  for(uint i=0; i<sigPhotons().size(); i++) fillKinematics(SusyKinematics::PHO, sigPhotons()[i]);
 }
 /*--------------------------------------------------------------------------------*/
 // Truth object selection
@@ -494,25 +879,58 @@ void SusyD3PDAna::selectTruthObjects()
 /*--------------------------------------------------------------------------------*/
 void SusyD3PDAna::clearObjects()
 {
-  m_preElectrons.clear();
-  m_preMuons.clear();
-  m_preJets.clear();
+  // All the collections, the trigger matching is kept for the systematics
+  m_objs.clear(SusyObjectFlags::OBJ_SELECTION);
   m_preLeptons.clear();
-  m_baseElectrons.clear();
-  m_baseMuons.clear();
   m_baseLeptons.clear();
-  m_baseJets.clear();
-  m_sigElectrons.clear();
-  m_sigMuons.clear();
   m_sigLeptons.clear();
-  m_sigJets.clear();
   m_cutFlags = 0;
 
-  m_sigPhotons.clear();
   m_truParticles.clear();
   m_truJets.clear();
 
-  m_metMuons.clear();
+  m_kin.clear();
+}
+
+/*--------------------------------------------------------------------------------*/
+// Kinematics table of the preselected objects, filled once per event and systematic
+/*--------------------------------------------------------------------------------*/
+void SusyD3PDAna::fillKinematics(uint collections)
+{
+  if(collections & (1u << SusyKinematics::ELE)){
+    m_kin.reset(SusyKinematics::ELE, d3pd.ele.n());
+    for(uint i=0; i<preElectrons().size(); i++) fillKinematics(SusyKinematics::ELE, preElectrons()[i]);
+  }
+  if(collections & (1u << SusyKinematics::MUO)){
+    m_kin.reset(SusyKinematics::MUO, d3pd.muo.n());
+    for(uint i=0; i<preMuons().size(); i++)     fillKinematics(SusyKinematics::MUO, preMuons()[i]);
+    // The met muons have a lower pt cut than the pre muons
+    for(uint i=0; i<metMuons().size(); i++){
+      if(!m_kin.isFilled(SusyKinematics::MUO, metMuons()[i]))
+        fillKinematics(SusyKinematics::MUO, metMuons()[i]);
+    }
+  }
+  if(collections & (1u << SusyKinematics::JET)){
+    m_kin.reset(SusyKinematics::JET, d3pd.jet.n());
+    for(uint i=0; i<preJets().size(); i++)      fillKinematics(SusyKinematics::JET, preJets()[i]);
+  }
+  if(collections & (1u << SusyKinematics::TAU)){
+    m_kin.reset(SusyKinematics::TAU, m_selectTaus? d3pd.tau.n() : 0);
+    for(uint i=0; i<contTaus().size(); i++)     fillKinematics(SusyKinematics::TAU, contTaus()[i]);
+    for(uint i=0; i<preTaus().size(); i++){
+      if(!m_kin.isFilled(SusyKinematics::TAU, preTaus()[i]))
+        fillKinematics(SusyKinematics::TAU, preTaus()[i]);
+    }
+  }
+}
+/*--------------------------------------------------------------------------------*/
+void SusyD3PDAna::fillKinematics(SusyKinematics::Collection c, int i)
+{
+  if(c == SusyKinematics::ELE)      m_kin.fill(c, i, m_susyObj.GetElecTLV(i), d3pd.ele[i].charge());
+  else if(c == SusyKinematics::MUO) m_kin.fill(c, i, m_susyObj.GetMuonTLV(i), d3pd.muo[i].charge());
+  else if(c == SusyKinematics::JET) m_kin.fill(c, i, m_susyObj.GetJetTLV(i));
+  else if(c == SusyKinematics::TAU) m_kin.fill(c, i, m_susyObj.GetTauTLV(i), d3pd.tau[i].charge());
+  else if(c == SusyKinematics::PHO) m_kin.fill(c, i, m_susyObj.GetPhotonTLV(i));
 }
 
 /*--------------------------------------------------------------------------------*/
@@ -520,10 +938,15 @@ void SusyD3PDAna::clearObjects()
 /*--------------------------------------------------------------------------------*/
 uint SusyD3PDAna::getNumGoodVtx()
 {
+  // Batch entries are seeded in GetEntry
+  if(memoHit(MEMO_NGOODVTX)) return m_memo.nGoodVtx;
+
   uint nVtx = 0;
   for(int i=0; i < d3pd.vtx.n(); i++){
     if(d3pd.vtx.nTracks()->at(i) >= 5) nVtx++;
   }
+  m_memo.nGoodVtx = nVtx;
+  memoSet(MEMO_NGOODVTX);
   return nVtx;
 }
 
@@ -532,13 +955,21 @@ uint SusyD3PDAna::getNumGoodVtx()
 /*--------------------------------------------------------------------------------*/
 bool SusyD3PDAna::matchTruthJet(int iJet)
 {
-  // Loop over truth jets looking for a match
-  const TLorentzVector* jetLV = & m_susyObj.GetJetTLV(iJet);
-  for(int i=0; i<d3pd.truthJet.n(); i++){
-    const TruthJetElement* trueJet = & d3pd.truthJet[i];
+  // The truth jets are added to the kinematics table with the first query of the event
+  uint nTruthJets = d3pd.truthJet.n();
+  if(m_kin.size(SusyKinematics::TRUTHJET) != nTruthJets){
+    m_kin.reset(SusyKinematics::TRUTHJET, nTruthJets);
     TLorentzVector trueJetLV;
-    trueJetLV.SetPtEtaPhiE(trueJet->pt(), trueJet->eta(), trueJet->phi(), trueJet->E());
-    if(jetLV->DeltaR(trueJetLV) < 0.3) return true;
+    for(uint i=0; i<nTruthJets; i++){
+      const TruthJetElement* trueJet = & d3pd.truthJet[i];
+      trueJetLV.SetPtEtaPhiE(trueJet->pt(), trueJet->eta(), trueJet->phi(), trueJet->E());
+      m_kin.fill(SusyKinematics::TRUTHJET, i, trueJetLV);
+    }
+  }
+
+  // Loop over truth jets looking for a match
+  for(uint i=0; i<nTruthJets; i++){
+    if(m_kin.deltaR(SusyKinematics::JET, iJet, SusyKinematics::TRUTHJET, i) < 0.3) return true;
   }
   return false;
 }
@@ -549,7 +980,13 @@ bool SusyD3PDAna::matchTruthJet(int iJet)
 void SusyD3PDAna::fillEventTriggers()
 {
   if(m_dbg>=5) cout << "fillEventTriggers" << endl;
-  
+
+  int iBatch = batchIndex();
+  if(iBatch >= 0){
+    m_evtTrigFlags = m_batch.trigFlags[iBatch];
+    return;
+  }
+
   m_evtTrigFlags = 0;
   // e7_medium1 not available at the moment, so use e7T for now
   //if(d3pd.trig.EF_e7_medium1())                 m_evtTrigFlags |= TRIG_e7_medium1;
@@ -601,11 +1038,11 @@ void SusyD3PDAna::fillEventTriggers()
   if(d3pd.trig.EF_mu24())                               m_evtTrigFlags |= TRIG_mu24;
   if(d3pd.trig.EF_mu4T_j65_a4tchad_xe70_tclcw_veryloose()) m_evtTrigFlags |= TRIG_mu4T_j65_a4tchad_xe70_tclcw_veryloose;
   if(d3pd.trig.EF_2mu4T_xe60_tclcw())                   m_evtTrigFlags |= TRIG_2mu4T_xe60_tclcw;
-  if(d3pd.trig.EF_2mu8_EFxe40_tclcw.IsAvailable() && d3pd.trig.EF_2mu8_EFxe40_tclcw())
+  if(m_hasTrig2mu8EFxe40 && d3pd.trig.EF_2mu8_EFxe40_tclcw())
     m_evtTrigFlags |= TRIG_2mu8_EFxe40_tclcw;
   if(d3pd.trig.EF_e24vh_medium1_EFxe35_tclcw())         m_evtTrigFlags |= TRIG_e24vh_medium1_EFxe35_tclcw;
   if(d3pd.trig.EF_mu24_j65_a4tchad_EFxe40_tclcw())      m_evtTrigFlags |= TRIG_mu24_j65_a4tchad_EFxe40_tclcw;
-  if(d3pd.trig.EF_mu24_j65_a4tchad_EFxe40wMu_tclcw.IsAvailable() && d3pd.trig.EF_mu24_j65_a4tchad_EFxe40wMu_tclcw())
+  if(m_hasTrigMu24j65EFxe40wMu && d3pd.trig.EF_mu24_j65_a4tchad_EFxe40wMu_tclcw())
     m_evtTrigFlags |= TRIG_mu24_j65_a4tchad_EFxe40wMu_tclcw;
 
   if(d3pd.trig.EF_e60_medium1())                        m_evtTrigFlags |= TRIG_e60_medium1;
@@ -622,9 +1059,10 @@ void SusyD3PDAna::matchElectronTriggers()
   //int run = d3pd.evt.RunNumber();
 
   // loop over all pre electrons
-  for(uint i=0; i<m_preElectrons.size(); i++){
-    int iEl = m_preElectrons[i];
-    const TLorentzVector* lv = & m_susyObj.GetElecTLV(iEl);
+  for(uint i=0; i<preElectrons().size(); i++){
+    int iEl = preElectrons()[i];
+    double eta = m_kin.eta(SusyKinematics::ELE, iEl);
+    double phi = m_kin.phi(SusyKinematics::ELE, iEl);
 
     // trigger flags
     long long flags = 0;
@@ -633,79 +1071,79 @@ void SusyD3PDAna::matchElectronTriggers()
 
     // e7_medium1
     // NOTE: This feature is not currently available in d3pds!! Use e7T for now!
-    //if( matchElectronTrigger(lv, d3pd.trig.trig_EF_el_EF_e7_medium1()) )
-    if( matchElectronTrigger(lv, d3pd.trig.trig_EF_el_EF_e7T_medium1()) ){
+    //if( matchElectronTrigger(eta, phi, d3pd.trig.trig_EF_el_EF_e7_medium1()) )
+    if( matchElectronTrigger(eta, phi, d3pd.trig.trig_EF_el_EF_e7T_medium1()) ){
       flags |= TRIG_e7_medium1;
     }
     // e12Tvh_loose1
-    if( matchElectronTrigger(lv, d3pd.trig.trig_EF_el_EF_e12Tvh_loose1()) ){
+    if( matchElectronTrigger(eta, phi, d3pd.trig.trig_EF_el_EF_e12Tvh_loose1()) ){
       flags |= TRIG_e12Tvh_loose1;
     }
     // e12Tvh_medium1
-    if( matchElectronTrigger(lv, d3pd.trig.trig_EF_el_EF_e12Tvh_medium1()) ){
+    if( matchElectronTrigger(eta, phi, d3pd.trig.trig_EF_el_EF_e12Tvh_medium1()) ){
       flags |= TRIG_e12Tvh_medium1;
     }
     // e24vh_medium1
-    if( matchElectronTrigger(lv, d3pd.trig.trig_EF_el_EF_e24vh_medium1()) ){
+    if( matchElectronTrigger(eta, phi, d3pd.trig.trig_EF_el_EF_e24vh_medium1()) ){
       flags |= TRIG_e24vh_medium1;
     }
     // e24vhi_medium1
-    if( matchElectronTrigger(lv, d3pd.trig.trig_EF_el_EF_e24vhi_medium1()) ){
+    if( matchElectronTrigger(eta, phi, d3pd.trig.trig_EF_el_EF_e24vhi_medium1()) ){
       flags |= TRIG_e24vhi_medium1;
     }
     // 2e12Tvh_loose1
-    if( matchElectronTrigger(lv, d3pd.trig.trig_EF_el_EF_2e12Tvh_loose1()) ){
+    if( matchElectronTrigger(eta, phi, d3pd.trig.trig_EF_el_EF_2e12Tvh_loose1()) ){
       flags |= TRIG_2e12Tvh_loose1;
     }
     // e24vh_medium1_e7_medium1 - NOTE: you don't know which feature it matches to!!
-    if( matchElectronTrigger(lv, d3pd.trig.trig_EF_el_EF_e24vh_medium1_e7_medium1()) ){
+    if( matchElectronTrigger(eta, phi, d3pd.trig.trig_EF_el_EF_e24vh_medium1_e7_medium1()) ){
       flags |= TRIG_e24vh_medium1_e7_medium1;
     }
     // e12Tvh_medium1_mu8
-    if( matchElectronTrigger(lv, d3pd.trig.trig_EF_el_EF_e12Tvh_medium1_mu8()) ){
+    if( matchElectronTrigger(eta, phi, d3pd.trig.trig_EF_el_EF_e12Tvh_medium1_mu8()) ){
       flags |= TRIG_e12Tvh_medium1_mu8;
     }
     // mu18_tight_e7_medium1 - NOTE: feature not available, so use e7_medium1 above!
-    //if( matchElectronTrigger(lv, d3pd.trig.trig_EF_el_EF_mu18_tight_e7_medium1()) ){
+    //if( matchElectronTrigger(eta, phi, d3pd.trig.trig_EF_el_EF_mu18_tight_e7_medium1()) ){
       //flags |= TRIG_mu18_tight_e7_medium1;
     //}
 
     // e18vh_medium1
-    if( matchElectronTrigger(lv, d3pd.trig.trig_EF_el_EF_e18vh_medium1()) ){
+    if( matchElectronTrigger(eta, phi, d3pd.trig.trig_EF_el_EF_e18vh_medium1()) ){
       flags |= TRIG_e18vh_medium1;
     }
 
     // e18vh_medium1_2e7T_medium1
-    if( matchElectronTrigger(lv, d3pd.trig.trig_EF_el_EF_e18vh_medium1_2e7T_medium1()) ){
+    if( matchElectronTrigger(eta, phi, d3pd.trig.trig_EF_el_EF_e18vh_medium1_2e7T_medium1()) ){
       flags |= TRIG_e18vh_medium1_2e7T_medium1;
     }
     // 2e7T_medium1_mu6
-    if( matchElectronTrigger(lv, d3pd.trig.trig_EF_el_EF_2e7T_medium1_mu6()) ){
+    if( matchElectronTrigger(eta, phi, d3pd.trig.trig_EF_el_EF_2e7T_medium1_mu6()) ){
       flags |= TRIG_2e7T_medium1_mu6;
     }
     // e7T_medium1_2mu6
-    if( matchElectronTrigger(lv, d3pd.trig.trig_EF_el_EF_e7T_medium1_2mu6()) ){
+    if( matchElectronTrigger(eta, phi, d3pd.trig.trig_EF_el_EF_e7T_medium1_2mu6()) ){
       flags |= TRIG_e7T_medium1_2mu6;
     }
 
     // e24vh_medium1_EFxe35_tclcw
-    if( matchElectronTrigger(lv, d3pd.trig.trig_EF_el_EF_e24vh_medium1_EFxe35_tclcw()) ){
+    if( matchElectronTrigger(eta, phi, d3pd.trig.trig_EF_el_EF_e24vh_medium1_EFxe35_tclcw()) ){
       flags |= TRIG_e24vh_medium1_EFxe35_tclcw;
     }
 
-    if(matchElectronTrigger(lv, d3pd.trig.trig_EF_el_EF_e60_medium1()) ){ flags |= TRIG_e60_medium1; }
+    if(matchElectronTrigger(eta, phi, d3pd.trig.trig_EF_el_EF_e60_medium1()) ){ flags |= TRIG_e60_medium1; }
 
     // assign the trigger flags for this electron
-    m_eleTrigFlags[iEl] = flags;
+    m_objs.setTrigFlags(SusyKinematics::ELE, iEl, flags);
   }
 }
 /*--------------------------------------------------------------------------------*/
-bool SusyD3PDAna::matchElectronTrigger(const TLorentzVector* lv, vector<int>* trigBools)
+bool SusyD3PDAna::matchElectronTrigger(double eta, double phi, vector<int>* trigBools)
 {
   // matched trigger index - not used
-  static int indexEF = -1;
+  int indexEF = -1;
   // Use function defined in egammaAnalysisUtils/egammaTriggerMatching.h
-  return PassedTriggerEF(lv->Eta(), lv->Phi(), trigBools, indexEF, d3pd.trig.trig_EF_el_n(), 
+  return PassedTriggerEF(eta, phi, trigBools, indexEF, d3pd.trig.trig_EF_el_n(), 
                          d3pd.trig.trig_EF_el_eta(), d3pd.trig.trig_EF_el_phi());
 }
 
@@ -718,142 +1156,142 @@ void SusyD3PDAna::matchMuonTriggers()
 
   //int run = d3pd.evt.RunNumber();
 
+  // Unpack the EF muon features once for all muons and chains
+  flattenMuonTriggerFeatures();
+
   // loop over all pre muons
-  for(uint i=0; i<m_preMuons.size(); i++){
+  for(uint i=0; i<preMuons().size(); i++){
+
+    int iMu = preMuons()[i];
+    double eta = m_kin.eta(SusyKinematics::MUO, iMu);
+    double phi = m_kin.phi(SusyKinematics::MUO, iMu);
 
-    int iMu = m_preMuons[i];
-    const TLorentzVector* lv = & m_susyObj.GetMuonTLV(iMu);
-    
     // trigger flags
     long long flags = 0;
 
     // 2012 triggers only
 
     // mu8
-    if( matchMuonTrigger(lv, d3pd.trig.trig_EF_trigmuonef_EF_mu8()) ) {
+    if( matchMuonTrigger(eta, phi, d3pd.trig.trig_EF_trigmuonef_EF_mu8()) ) {
       flags |= TRIG_mu8;
     }
     // mu13
-    if( matchMuonTrigger(lv, d3pd.trig.trig_EF_trigmuonef_EF_mu13()) ){
+    if( matchMuonTrigger(eta, phi, d3pd.trig.trig_EF_trigmuonef_EF_mu13()) ){
       flags |= TRIG_mu13;
     }
     // mu18_tight
-    if( matchMuonTrigger(lv, d3pd.trig.trig_EF_trigmuonef_EF_mu18_tight()) ) {
+    if( matchMuonTrigger(eta, phi, d3pd.trig.trig_EF_trigmuonef_EF_mu18_tight()) ) {
       flags |= TRIG_mu18_tight;
     }
     // mu24i_tight
-    if( matchMuonTrigger(lv, d3pd.trig.trig_EF_trigmuonef_EF_mu24i_tight()) ) {
+    if( matchMuonTrigger(eta, phi, d3pd.trig.trig_EF_trigmuonef_EF_mu24i_tight()) ) {
       flags |= TRIG_mu24i_tight;
     }
     // 2mu13
-    if( matchMuonTrigger(lv, d3pd.trig.trig_EF_trigmuonef_EF_2mu13()) ) {
+    if( matchMuonTrigger(eta, phi, d3pd.trig.trig_EF_trigmuonef_EF_2mu13()) ) {
       flags |= TRIG_2mu13;
     }
     // mu18_tight_mu8_EFFS
-    if( matchMuonTrigger(lv, d3pd.trig.trig_EF_trigmuonef_EF_mu18_tight_mu8_EFFS()) ) {
+    if( matchMuonTrigger(eta, phi, d3pd.trig.trig_EF_trigmuonef_EF_mu18_tight_mu8_EFFS()) ) {
       flags |= TRIG_mu18_tight_mu8_EFFS;
     }
     // e12Tvh_medium1_mu8 - NOTE: muon feature not available, so use mu8
-    //if( matchMuonTrigger(lv, d3pd.trig.trig_EF_trigmuonef_EF_mu8()) ) {
+    //if( matchMuonTrigger(eta, phi, d3pd.trig.trig_EF_trigmuonef_EF_mu8()) ) {
       //flags |= TRIG_e12Tvh_medium1_mu8;
     //}
     // mu18_tight_e7_medium1
-    if( matchMuonTrigger(lv, d3pd.trig.trig_EF_trigmuonef_EF_mu18_tight_e7_medium1()) ) {
+    if( matchMuonTrigger(eta, phi, d3pd.trig.trig_EF_trigmuonef_EF_mu18_tight_e7_medium1()) ) {
       flags |= TRIG_mu18_tight_e7_medium1;
     }
 
     // mu15
-    if( matchMuonTrigger(lv, d3pd.trig.trig_EF_trigmuonef_EF_mu15()) ) {
+    if( matchMuonTrigger(eta, phi, d3pd.trig.trig_EF_trigmuonef_EF_mu15()) ) {
       flags |= TRIG_mu15;
     }
 
     // 2mu8_EFxe40wMu_tclcw
     if(!m_isMC && d3pd.evt.RunNumber()>=206248 &&
-       matchMuonTrigger(lv, d3pd.trig.trig_EF_trigmuonef_EF_2mu8_EFxe40wMu_tclcw())) {
+       matchMuonTrigger(eta, phi, d3pd.trig.trig_EF_trigmuonef_EF_2mu8_EFxe40wMu_tclcw())) {
       flags |= TRIG_2mu8_EFxe40wMu_tclcw;
     }
 
     // mu6
-    if( matchMuonTrigger(lv, d3pd.trig.trig_EF_trigmuonef_EF_mu6()) ) {
+    if( matchMuonTrigger(eta, phi, d3pd.trig.trig_EF_trigmuonef_EF_mu6()) ) {
       flags |= TRIG_mu6;
     }
     // 2mu6
-    if( matchMuonTrigger(lv, d3pd.trig.trig_EF_trigmuonef_EF_2mu6()) ) {
+    if( matchMuonTrigger(eta, phi, d3pd.trig.trig_EF_trigmuonef_EF_2mu6()) ) {
       flags |= TRIG_2mu6;
     }
     // 3mu6
-    //if( matchMuonTrigger(lv, d3pd.trig.trig_EF_trigmuonef_EF_3mu6()) ) {
+    //if( matchMuonTrigger(eta, phi, d3pd.trig.trig_EF_trigmuonef_EF_3mu6()) ) {
       //flags |= TRIG_3mu6;
     //}
     // mu18_tight_2mu4_EFFS
-    if( matchMuonTrigger(lv, d3pd.trig.trig_EF_trigmuonef_EF_mu18_tight_2mu4_EFFS()) ) {
+    if( matchMuonTrigger(eta, phi, d3pd.trig.trig_EF_trigmuonef_EF_mu18_tight_2mu4_EFFS()) ) {
       flags |= TRIG_mu18_tight_2mu4_EFFS;
     }
 
     // mu4T
-    if( matchMuonTrigger(lv, d3pd.trig.trig_EF_trigmuonef_EF_mu4T()) ) {
+    if( matchMuonTrigger(eta, phi, d3pd.trig.trig_EF_trigmuonef_EF_mu4T()) ) {
       flags |= TRIG_mu4T;
     }
     // mu24
-    if( matchMuonTrigger(lv, d3pd.trig.trig_EF_trigmuonef_EF_mu24()) ) {
+    if( matchMuonTrigger(eta, phi, d3pd.trig.trig_EF_trigmuonef_EF_mu24()) ) {
       flags |= TRIG_mu24;
     }
     // mu4T_j65_a4tchad_xe70_tclcw_veryloose
-    if( matchMuonTrigger(lv, d3pd.trig.trig_EF_trigmuonef_EF_mu4T_j65_a4tchad_xe70_tclcw_veryloose()) ) {
+    if( matchMuonTrigger(eta, phi, d3pd.trig.trig_EF_trigmuonef_EF_mu4T_j65_a4tchad_xe70_tclcw_veryloose()) ) {
       flags |= TRIG_mu4T_j65_a4tchad_xe70_tclcw_veryloose;
     }
     // 2mu4T_xe60_tclcw
-    if( matchMuonTrigger(lv, d3pd.trig.trig_EF_trigmuonef_EF_2mu4T_xe60_tclcw()) ) {
+    if( matchMuonTrigger(eta, phi, d3pd.trig.trig_EF_trigmuonef_EF_2mu4T_xe60_tclcw()) ) {
       flags |= TRIG_2mu4T_xe60_tclcw;
     }
     // 2mu8_EFxe40_tclcw
-    if(d3pd.trig.trig_EF_trigmuonef_EF_2mu8_EFxe40_tclcw.IsAvailable() &&
-       matchMuonTrigger(lv, d3pd.trig.trig_EF_trigmuonef_EF_2mu8_EFxe40_tclcw()) ) {
+    if(m_hasMuTrig2mu8EFxe40 &&
+       matchMuonTrigger(eta, phi, d3pd.trig.trig_EF_trigmuonef_EF_2mu8_EFxe40_tclcw()) ) {
       flags |= TRIG_2mu8_EFxe40_tclcw;
     }
     // mu24_j65_a4tchad_EFxe40_tclcw
-    if( matchMuonTrigger(lv, d3pd.trig.trig_EF_trigmuonef_EF_mu24_j65_a4tchad_EFxe40_tclcw()) ) {
+    if( matchMuonTrigger(eta, phi, d3pd.trig.trig_EF_trigmuonef_EF_mu24_j65_a4tchad_EFxe40_tclcw()) ) {
       flags |= TRIG_mu24_j65_a4tchad_EFxe40_tclcw;
     }
     // mu24_j65_a4tchad_EFxe40wMu_tclcw
-    if(d3pd.trig.trig_EF_trigmuonef_EF_mu24_j65_a4tchad_EFxe40wMu_tclcw.IsAvailable() &&
-       matchMuonTrigger(lv, d3pd.trig.trig_EF_trigmuonef_EF_mu24_j65_a4tchad_EFxe40wMu_tclcw()) ) {
+    if(m_hasMuTrigMu24j65EFxe40wMu &&
+       matchMuonTrigger(eta, phi, d3pd.trig.trig_EF_trigmuonef_EF_mu24_j65_a4tchad_EFxe40wMu_tclcw()) ) {
       flags |= TRIG_mu24_j65_a4tchad_EFxe40wMu_tclcw;
     }
 
-    if(d3pd.trig.trig_EF_trigmuonef_EF_mu24_tight.IsAvailable() &&
-       matchMuonTrigger(lv, d3pd.trig.trig_EF_trigmuonef_EF_mu24_tight()) ) { flags |= TRIG_mu24_tight; }
-    if(d3pd.trig.trig_EF_trigmuonef_EF_mu36_tight.IsAvailable() &&
-       matchMuonTrigger(lv, d3pd.trig.trig_EF_trigmuonef_EF_mu36_tight()) ) { flags |= TRIG_mu36_tight; }
+    if(m_hasMuTrigMu24tight &&
+       matchMuonTrigger(eta, phi, d3pd.trig.trig_EF_trigmuonef_EF_mu24_tight()) ) { flags |= TRIG_mu24_tight; }
+    if(m_hasMuTrigMu36tight &&
+       matchMuonTrigger(eta, phi, d3pd.trig.trig_EF_trigmuonef_EF_mu36_tight()) ) { flags |= TRIG_mu36_tight; }
 
     // assign the trigger flags for this muon
-    m_muoTrigFlags[iMu] = flags;
+    m_objs.setTrigFlags(SusyKinematics::MUO, iMu, flags);
   }
 }
 /*--------------------------------------------------------------------------------*/
-bool SusyD3PDAna::matchMuonTrigger(const TLorentzVector* lv, vector<int>* passTrig)
+bool SusyD3PDAna::matchMuonTrigger(double eta, double phi, vector<int>* passTrig)
 {
+  // Same as TLorentzVector::DeltaR, with the offline and trigger track eta/phi precomputed
+
   // loop over muon trigger features
-  for(int iTrig=0; iTrig < d3pd.trig.trig_EF_trigmuonef_n(); iTrig++){
+  uint nTrig = m_muTrigOffset.size() - 1;
+  for(uint iTrig=0; iTrig < nTrig; iTrig++){
 
     // Check to see if this feature passed chain we want
     if(passTrig->at(iTrig)){
 
-      // Loop over muon EF tracks
-      TLorentzVector lvTrig;
-      for(int iTrk=0; iTrk < d3pd.trig.trig_EF_trigmuonef_track_n()->at(iTrig); iTrk++){
-
-        lvTrig.SetPtEtaPhiM( d3pd.trig.trig_EF_trigmuonef_track_CB_pt()->at(iTrig).at(iTrk),
-                             d3pd.trig.trig_EF_trigmuonef_track_CB_eta()->at(iTrig).at(iTrk),
-                             d3pd.trig.trig_EF_trigmuonef_track_CB_phi()->at(iTrig).at(iTrk),
-                             0 );       // only eta and phi used to compute dR anyway
-        // Require combined offline track...?
-        if(!d3pd.trig.trig_EF_trigmuonef_track_CB_hasCB()->at(iTrig).at(iTrk)) continue;
-        float dR = lv->DeltaR(lvTrig);
+      // Loop over the combined muon EF tracks of this feature
+      for(int iTrk=m_muTrigOffset[iTrig]; iTrk < m_muTrigOffset[iTrig+1]; iTrk++){
+        double dEta = eta - m_muTrigEta[iTrk];
+        double dPhi = TVector2::Phi_mpi_pi(phi - m_muTrigPhi[iTrk]);
+        float dR = sqrt(dEta*dEta + dPhi*dPhi);
         if(dR < 0.15){
           return true;
         }
-
       } // loop over EF tracks
     } // trigger object passes chain?
   } // loop over trigger objects
@@ -861,6 +1299,32 @@ bool SusyD3PDAna::matchMuonTrigger(const TLorentzVector* lv, vector<int>* passTr
   // matching failed
   return false;
 }
+/*--------------------------------------------------------------------------------*/
+void SusyD3PDAna::flattenMuonTriggerFeatures()
+{
+  // The nested vectors are walked once per event. Only the tracks with a combined
+  // muon are kept, since the others are never matched. The eta and phi go through
+  // a TLorentzVector so that the dR values are the same as before the unpacking.
+  int nTrig = d3pd.trig.trig_EF_trigmuonef_n();
+  m_muTrigOffset.assign(1, 0);
+  m_muTrigEta.clear();
+  m_muTrigPhi.clear();
+  if(nTrig == 0) return;
+
+  TLorentzVector lvTrig;
+  for(int iTrig=0; iTrig < nTrig; iTrig++){
+    for(int iTrk=0; iTrk < d3pd.trig.trig_EF_trigmuonef_track_n()->at(iTrig); iTrk++){
+      if(!d3pd.trig.trig_EF_trigmuonef_track_CB_hasCB()->at(iTrig).at(iTrk)) continue;
+      lvTrig.SetPtEtaPhiM( d3pd.trig.trig_EF_trigmuonef_track_CB_pt()->at(iTrig).at(iTrk),
+                           d3pd.trig.trig_EF_trigmuonef_track_CB_eta()->at(iTrig).at(iTrk),
+                           d3pd.trig.trig_EF_trigmuonef_track_CB_phi()->at(iTrig).at(iTrk),
+                           0 );       // only eta and phi used to compute dR anyway
+      m_muTrigEta.push_back(lvTrig.Eta());
+      m_muTrigPhi.push_back(lvTrig.Phi());
+    }
+    m_muTrigOffset.push_back(m_muTrigEta.size());
+  }
+}
 
 /*--------------------------------------------------------------------------------*/
 // Tau trigger matching
@@ -872,56 +1336,59 @@ void SusyD3PDAna::matchTauTriggers()
   //int run = d3pd.evt.RunNumber();
 
   // loop over all pre taus
-  for(uint i=0; i<m_preTaus.size(); i++){
+  for(uint i=0; i<preTaus().size(); i++){
+
+    int iTau = preTaus()[i];
+    double eta = m_kin.eta(SusyKinematics::TAU, iTau);
+    double phi = m_kin.phi(SusyKinematics::TAU, iTau);
 
-    int iTau = m_preTaus[i];
-    //const TLorentzVector* lv = & m_tauLVs[iTau];
-    const TLorentzVector* lv = & m_susyObj.GetTauTLV(iTau);
-    
     // trigger flags
     long long flags = 0;
 
     // tau20_medium1
-    if( matchTauTrigger(lv, d3pd.trig.trig_EF_tau_EF_tau20_medium1()) ){
+    if( matchTauTrigger(eta, phi, d3pd.trig.trig_EF_tau_EF_tau20_medium1()) ){
       flags |= TRIG_tau20_medium1;
     }
     // tau20Ti_medium1
-    if( matchTauTrigger(lv, d3pd.trig.trig_EF_tau_EF_tau20Ti_medium1()) ){
+    if( matchTauTrigger(eta, phi, d3pd.trig.trig_EF_tau_EF_tau20Ti_medium1()) ){
       flags |= TRIG_tau20Ti_medium1;
     }
     // tau29Ti_medium1
-    if( matchTauTrigger(lv, d3pd.trig.trig_EF_tau_EF_tau29Ti_medium1()) ){
+    if( matchTauTrigger(eta, phi, d3pd.trig.trig_EF_tau_EF_tau29Ti_medium1()) ){
       flags |= TRIG_tau29Ti_medium1;
     }
     // tau29Ti_medium1_tau20Ti_medium1
-    if( matchTauTrigger(lv, d3pd.trig.trig_EF_tau_EF_tau29Ti_medium1_tau20Ti_medium1()) ){
+    if( matchTauTrigger(eta, phi, d3pd.trig.trig_EF_tau_EF_tau29Ti_medium1_tau20Ti_medium1()) ){
       flags |= TRIG_tau29Ti_medium1_tau20Ti_medium1;
     }
     // tau20Ti_medium1_e18vh_medium1
-    if( matchTauTrigger(lv, d3pd.trig.trig_EF_tau_EF_tau20Ti_medium1_e18vh_medium1()) ){
+    if( matchTauTrigger(eta, phi, d3pd.trig.trig_EF_tau_EF_tau20Ti_medium1_e18vh_medium1()) ){
       flags |= TRIG_tau20Ti_medium1_e18vh_medium1;
     }
     // tau20_medium1_mu15
-    if( matchTauTrigger(lv, d3pd.trig.trig_EF_tau_EF_tau20_medium1_mu15()) ){
+    if( matchTauTrigger(eta, phi, d3pd.trig.trig_EF_tau_EF_tau20_medium1_mu15()) ){
       flags |= TRIG_tau20_medium1_mu15;
     }
 
     // assign the trigger flags for this tau
-    m_tauTrigFlags[iTau] = flags;
+    m_objs.setTrigFlags(SusyKinematics::TAU, iTau, flags);
   }
 }
 /*--------------------------------------------------------------------------------*/
-bool SusyD3PDAna::matchTauTrigger(const TLorentzVector* lv, vector<int>* passTrig)
+bool SusyD3PDAna::matchTauTrigger(double eta, double phi, vector<int>* passTrig)
 {
   // loop over tau trigger features
   for(int iTrig=0; iTrig < d3pd.trig.trig_EF_tau_n(); iTrig++){
     // Check to see if this feature passed chain we want
     if(passTrig->at(iTrig)){
       // Now, try to match offline tau to this online tau
-      static TLorentzVector trigLV;
+      TLorentzVector trigLV;
       trigLV.SetPtEtaPhiM(d3pd.trig.trig_EF_tau_pt()->at(iTrig), d3pd.trig.trig_EF_tau_eta()->at(iTrig), 
                           d3pd.trig.trig_EF_tau_phi()->at(iTrig), d3pd.trig.trig_EF_tau_m()->at(iTrig));
-      float dR = lv->DeltaR(trigLV);
+      // Same as TLorentzVector::DeltaR
+      double dEta = eta - trigLV.Eta();
+      double dPhi = TVector2::Phi_mpi_pi(phi - trigLV.Phi());
+      float dR = sqrt(dEta*dEta + dPhi*dPhi);
       if(dR < 0.15) return true;
     }
   }
@@ -934,13 +1401,33 @@ bool SusyD3PDAna::matchTauTrigger(const TLorentzVector* lv, vector<int>* passTri
 /*--------------------------------------------------------------------------------*/
 void SusyD3PDAna::checkEventCleaning()
 {
+  checkEventInfoCleaning();
+  checkVertexCleaning();
+}
+/*--------------------------------------------------------------------------------*/
+void SusyD3PDAna::checkEventInfoCleaning()
+{
+  int iBatch = batchIndex();
+  if(iBatch >= 0){
+    m_cutFlags |= m_batch.cutFlags[iBatch] & ~ECut_GoodVtx;
+    return;
+  }
   if(passGRL())      m_cutFlags |= ECut_GRL;
   if(passTTCVeto())  m_cutFlags |= ECut_TTC;
   if(passLarErr())   m_cutFlags |= ECut_LarErr;
   if(passTileErr())  m_cutFlags |= ECut_TileErr;
-  if(passGoodVtx())  m_cutFlags |= ECut_GoodVtx;
   if(passTileTrip()) m_cutFlags |= ECut_TileTrip;
 }
+/*--------------------------------------------------------------------------------*/
+void SusyD3PDAna::checkVertexCleaning()
+{
+  int iBatch = batchIndex();
+  if(iBatch >= 0){
+    m_cutFlags |= m_batch.cutFlags[iBatch] & ECut_GoodVtx;
+    return;
+  }
+  if(passGoodVtx())  m_cutFlags |= ECut_GoodVtx;
+}
 
 /*--------------------------------------------------------------------------------*/
 // Check object level cleaning cuts like BadJet, BadMu, etc.
@@ -977,14 +1464,14 @@ bool SusyD3PDAna::passLarHoleVeto()
 /*--------------------------------------------------------------------------------*/
 bool SusyD3PDAna::passTileHotSpot()
 {
-  return !check_jet_tileHotSpot(&d3pd.jet, m_preJets, m_susyObj, !m_isMC, d3pd.evt.RunNumber());
+  return !check_jet_tileHotSpot(&d3pd.jet, preJets(), m_susyObj, !m_isMC, d3pd.evt.RunNumber());
 }
 /*--------------------------------------------------------------------------------*/
 // Pass bad jet cut
 /*--------------------------------------------------------------------------------*/
 bool SusyD3PDAna::passBadJet()
 {
-  return !IsBadJetEvent(&d3pd.jet, m_baseJets, 20.*GeV, m_susyObj);
+  return !IsBadJetEvent(&d3pd.jet, baseJets(), 20.*GeV, m_susyObj);
 }
 /*--------------------------------------------------------------------------------*/
 // Pass good vertex
@@ -1005,14 +1492,14 @@ bool SusyD3PDAna::passTileTrip()
 /*--------------------------------------------------------------------------------*/
 bool SusyD3PDAna::passBadMuon()
 {
-  return !IsBadMuonEvent(m_susyObj, &d3pd.muo, m_preMuons, 0.2);
+  return !IsBadMuonEvent(m_susyObj, &d3pd.muo, preMuons(), 0.2);
 }
 /*--------------------------------------------------------------------------------*/
 // Pass cosmic veto
 /*--------------------------------------------------------------------------------*/
 bool SusyD3PDAna::passCosmic()
 {
-  return !IsCosmic(m_susyObj, &d3pd.muo, m_baseMuons, 1., 0.2);
+  return !IsCosmic(m_susyObj, &d3pd.muo, baseMuons(), 1., 0.2);
 }
 
 /*--------------------------------------------------------------------------------*/
@@ -1036,19 +1523,29 @@ bool SusyD3PDAna::passCosmic()
 float SusyD3PDAna::getEventWeight(float lumi)
 {
   if(!m_isMC) return 1;
-  return d3pd.truth.event_weight() * getXsecWeight() * getPileupWeight() * lumi / m_sumw;
+  return getGenWeight() * getXsecWeight() * getPileupWeight() * lumi / m_sumw;
 }
 /*--------------------------------------------------------------------------------*/
 float SusyD3PDAna::getEventWeightAtoB3()
 {
   if(!m_isMC) return 1;
-  return d3pd.truth.event_weight() * getXsecWeight() * getPileupWeightAB3() * LUMI_A_B3 / m_sumw;
+  return getGenWeight() * getXsecWeight() * getPileupWeightAB3() * LUMI_A_B3 / m_sumw;
 }
 /*--------------------------------------------------------------------------------*/
 float SusyD3PDAna::getEventWeightAtoB()
 {
   if(!m_isMC) return 1;
-  return d3pd.truth.event_weight() * getXsecWeight() * getPileupWeightAB() * LUMI_A_B14 / m_sumw;
+  return getGenWeight() * getXsecWeight() * getPileupWeightAB() * LUMI_A_B14 / m_sumw;
+}
+
+/*--------------------------------------------------------------------------------*/
+// Generator weight
+/*--------------------------------------------------------------------------------*/
+float SusyD3PDAna::getGenWeight()
+{
+  int iBatch = batchIndex();
+  if(iBatch >= 0) return m_batch.genWeight[iBatch];
+  return d3pd.truth.event_weight();
 }
 
 /*--------------------------------------------------------------------------------*/
@@ -1059,12 +1556,19 @@ float SusyD3PDAna::getXsecWeight()
   // Use user cross section if it has been set
   if(m_xsec > 0) return m_xsec;
 
-  // Use SUSY cross section file
+  // Use SUSY cross section file. The product is resolved on the first event of
+  // each file (see Notify) and again only if the channel changes within the file
   int id = d3pd.truth.channel_number();
-  if(m_xsecMap.find(id) == m_xsecMap.end()) {
-    m_xsecMap[id] = m_susyXsec->process(id);
+  if(id != m_xsecChannel){
+    map<int,SUSY::CrossSectionDB::Process>::iterator it = m_xsecMap.find(id);
+    if(it == m_xsecMap.end()){
+      R__LOCKGUARD(m_toolMutex);
+      it = m_xsecMap.insert(make_pair(id, m_susyXsec->process(id))).first;
+    }
+    m_xsecWeight  = it->second.xsect() * it->second.kfactor() * it->second.efficiency();
+    m_xsecChannel = id;
   }
-  return m_xsecMap[id].xsect() * m_xsecMap[id].kfactor() * m_xsecMap[id].efficiency();
+  return m_xsecWeight;
 }
 
 /*--------------------------------------------------------------------------------*/
@@ -1076,35 +1580,28 @@ float SusyD3PDAna::getLumiWeight()
 /*--------------------------------------------------------------------------------*/
 // Pileup reweighting
 /*--------------------------------------------------------------------------------*/
-float SusyD3PDAna::getPileupWeight()
+SusyPileupWeights::Weights SusyD3PDAna::getPileupWeights()
 {
-  return m_pileup->GetCombinedWeight(d3pd.evt.RunNumber(), d3pd.truth.channel_number(), d3pd.evt.averageIntPerXing());
+  if(memoHit(MEMO_PILEUP)) return m_memo.pileup;
+  R__LOCKGUARD(m_toolMutex);
+  m_memo.pileup = m_pileupWeights->getWeights(d3pd.evt.RunNumber(), d3pd.truth.channel_number(),
+                                              d3pd.evt.averageIntPerXing());
+  memoSet(MEMO_PILEUP);
+  return m_memo.pileup;
 }
 /*--------------------------------------------------------------------------------*/
+float SusyD3PDAna::getPileupWeight()
+{ return getPileupWeights().w[SusyPileupWeights::PU_NOM]; }
 float SusyD3PDAna::getPileupWeightUp()
-{
-  return m_pileup_up->GetCombinedWeight(d3pd.evt.RunNumber(), d3pd.truth.channel_number(), d3pd.evt.averageIntPerXing());
-}
-/*--------------------------------------------------------------------------------*/
+{ return getPileupWeights().w[SusyPileupWeights::PU_UP]; }
 float SusyD3PDAna::getPileupWeightDown()
-{
-  return m_pileup_dn->GetCombinedWeight(d3pd.evt.RunNumber(), d3pd.truth.channel_number(), d3pd.evt.averageIntPerXing());
-}
-/*--------------------------------------------------------------------------------*/
+{ return getPileupWeights().w[SusyPileupWeights::PU_DN]; }
 float SusyD3PDAna::getPileupWeightAB3()
-{
-  return m_pileupAB3->GetCombinedWeight(d3pd.evt.RunNumber(), d3pd.truth.channel_number(), d3pd.evt.averageIntPerXing());
-}
-/*--------------------------------------------------------------------------------*/
+{ return getPileupWeights().w[SusyPileupWeights::PU_AB3]; }
 float SusyD3PDAna::getPileupWeightAB()
-{
-  return m_pileupAB->GetCombinedWeight(d3pd.evt.RunNumber(), d3pd.truth.channel_number(), d3pd.evt.averageIntPerXing());
-}
-/*--------------------------------------------------------------------------------*/
+{ return getPileupWeights().w[SusyPileupWeights::PU_AB]; }
 float SusyD3PDAna::getPileupWeightAE()
-{
-  return m_pileupAE->GetCombinedWeight(d3pd.evt.RunNumber(), d3pd.truth.channel_number(), d3pd.evt.averageIntPerXing());
-}
+{ return getPileupWeights().w[SusyPileupWeights::PU_AE]; }
 
 /*--------------------------------------------------------------------------------*/
 // PDF reweighting of 7TeV -> 8TeV
@@ -1150,7 +1647,7 @@ float SusyD3PDAna::getLepSF(const vector<LeptonInfo>& leptons)
       // Electrons
       if(lep->isElectron()){
         const ElectronElement* el = lep->getElectronElement();
-        lepSF *= m_susyObj.GetSignalElecSF(el->cl_eta(), lep->lv()->Pt(), true, true, false);
+        lepSF *= m_susyObj.GetSignalElecSF(el->cl_eta(), m_kin.pt(SusyKinematics::ELE, lep->idx()), true, true, false);
       }
       // Muons
       else{
@@ -1176,10 +1673,22 @@ float SusyD3PDAna::getBTagSF(const vector<int>& jets)
 /*--------------------------------------------------------------------------------*/
 void SusyD3PDAna::calcRandomRunLB()
 {
-  if(m_pileup){
-    m_mcRun = m_pileup->GetRandomRunNumber(d3pd.evt.RunNumber());
-    m_mcLB = m_pileup->GetRandomLumiBlockNumber(m_mcRun);
+  // Drawn once per entry, so every use in the event sees the same numbers. The
+  // draw is seeded from the event, so it is the same in serial and threaded jobs
+  if(memoHit(MEMO_RANDOMRUNLB)){
+    m_mcRun = m_memo.mcRun;
+    m_mcLB  = m_memo.mcLB;
+    return;
   }
+  if(m_pileupWeights){
+    R__LOCKGUARD(m_toolMutex);
+    m_pileupWeights->setRandomSeed(d3pd.evt.RunNumber(), d3pd.evt.EventNumber());
+    m_mcRun = m_pileupWeights->getRandomRunNumber(d3pd.evt.RunNumber());
+    m_mcLB = m_pileupWeights->getRandomLumiBlockNumber(m_mcRun);
+  }
+  m_memo.mcRun = m_mcRun;
+  m_memo.mcLB  = m_mcLB;
+  memoSet(MEMO_RANDOMRUNLB);
 }
 
 /*--------------------------------------------------------------------------------*/
@@ -1187,18 +1696,45 @@ void SusyD3PDAna::calcRandomRunLB()
 /*--------------------------------------------------------------------------------*/
 int SusyD3PDAna::getHFORDecision()
 {
-  return m_hforTool.getDecision(d3pd.truth.channel_number(),
-                                d3pd.truth.n(),
-                                d3pd.truth.pt(),
-                                d3pd.truth.eta(),
-                                d3pd.truth.phi(),
-                                d3pd.truth.m(),
-                                d3pd.truth.pdgId(),
-                                d3pd.truth.status(),
-                                d3pd.truth.vx_barcode(),
-                                d3pd.truth.parent_index(),
-                                d3pd.truth.child_index(),
-                                HforToolD3PD::ALL); //HforToolD3PD::DEFAULT
+  if(memoHit(MEMO_HFOR)) return m_memo.hfor;
+  m_memo.hfor = m_hforTool.getDecision(d3pd.truth.channel_number(),
+                                       d3pd.truth.n(),
+                                       d3pd.truth.pt(),
+                                       d3pd.truth.eta(),
+                                       d3pd.truth.phi(),
+                                       d3pd.truth.m(),
+                                       d3pd.truth.pdgId(),
+                                       d3pd.truth.status(),
+                                       d3pd.truth.vx_barcode(),
+                                       d3pd.truth.parent_index(),
+                                       d3pd.truth.child_index(),
+                                       HforToolD3PD::ALL); //HforToolD3PD::DEFAULT
+  memoSet(MEMO_HFOR);
+  return m_memo.hfor;
+}
+
+/*--------------------------------------------------------------------------------*/
+// SUSY final state of the sparticle pair
+/*--------------------------------------------------------------------------------*/
+int SusyD3PDAna::getSusyFinalState()
+{
+  if(memoHit(MEMO_FINALSTATE)) return m_memo.finalState;
+  m_memo.finalState = m_susyObj.finalState(d3pd.evt.SUSY_Spart1_pdgId(), d3pd.evt.SUSY_Spart2_pdgId());
+  memoSet(MEMO_FINALSTATE);
+  return m_memo.finalState;
+}
+
+/*--------------------------------------------------------------------------------*/
+// Event memo statistics
+/*--------------------------------------------------------------------------------*/
+void SusyD3PDAna::printMemoStats()
+{
+  const char* names[N_MEMO_ITEMS] = { "nGoodVtx", "hfor", "finalState", "randomRunLB", "pileup" };
+  cout << "Event memo: lookups, computed" << endl;
+  for(int i=0; i<N_MEMO_ITEMS; i++){
+    cout << "  " << setw(12) << left << names[i] << right
+         << setw(10) << m_memo.hits[i] + m_memo.misses[i] << setw(10) << m_memo.misses[i] << endl;
+  }
 }
 
 /*--------------------------------------------------------------------------------*/
@@ -1236,23 +1772,22 @@ void SusyD3PDAna::dumpEvent()
 /*--------------------------------------------------------------------------------*/
 void SusyD3PDAna::dumpBaselineObjects()
 {
-  uint nEle = m_baseElectrons.size();
-  uint nMu  = m_baseMuons.size();
-  //uint nTau = m_baseTaus.size();
-  uint nJet = m_baseJets.size();
+  uint nEle = baseElectrons().size();
+  uint nMu  = baseMuons().size();
+  //uint nTau = baseTaus().size();
+  uint nJet = baseJets().size();
 
   cout.precision(2);
   if(nEle){
     cout << "Baseline electrons" << endl;
     for(uint i=0; i < nEle; i++){
-      int iEl = m_baseElectrons[i];
-      const TLorentzVector* lv = & m_susyObj.GetElecTLV(iEl);
+      int iEl = baseElectrons()[i];
       const ElectronElement* ele = & d3pd.ele[iEl];
       cout << "  El : " << fixed
            << " q " << setw(2) << (int) ele->charge()
-           << " pt " << setw(6) << lv->Pt()/GeV
-           << " eta " << setw(5) << lv->Eta()
-           << " phi " << setw(5) << lv->Phi();
+           << " pt " << setw(6) << m_kin.pt(SusyKinematics::ELE, iEl)/GeV
+           << " eta " << setw(5) << m_kin.eta(SusyKinematics::ELE, iEl)
+           << " phi " << setw(5) << m_kin.phi(SusyKinematics::ELE, iEl);
       if(m_isMC) cout << " type " << setw(2) << ele->type() << " origin " << setw(2) << ele->origin();
       cout << endl;
     }
@@ -1260,14 +1795,13 @@ void SusyD3PDAna::dumpBaselineObjects()
   if(nMu){
     cout << "Baseline muons" << endl;
     for(uint i=0; i < nMu; i++){
-      int iMu = m_baseMuons[i];
-      const TLorentzVector* lv = & m_susyObj.GetMuonTLV(iMu);
+      int iMu = baseMuons()[i];
       const MuonElement* muo = & d3pd.muo[iMu];
       cout << "  Mu : " << fixed
            << " q " << setw(2) << (int) muo->charge()
-           << " pt " << setw(6) << lv->Pt()/GeV
-           << " eta " << setw(5) << lv->Eta()
-           << " phi " << setw(5) << lv->Phi();
+           << " pt " << setw(6) << m_kin.pt(SusyKinematics::MUO, iMu)/GeV
+           << " eta " << setw(5) << m_kin.eta(SusyKinematics::MUO, iMu)
+           << " phi " << setw(5) << m_kin.phi(SusyKinematics::MUO, iMu);
       if(m_isMC) cout << " type " << setw(2) << muo->type() << " origin " << setw(2) << muo->origin();
       cout << endl;
     }
@@ -1275,13 +1809,12 @@ void SusyD3PDAna::dumpBaselineObjects()
   if(nJet){
     cout << "Baseline jets" << endl;
     for(uint i=0; i < nJet; i++){
-      int iJet = m_baseJets[i];
-      const TLorentzVector* lv = & m_susyObj.GetJetTLV(iJet);
+      int iJet = baseJets()[i];
       const JetElement* jet = & d3pd.jet[iJet];
       cout << "  Jet : " << fixed
-           << " pt " << setw(6) << lv->Pt()/GeV
-           << " eta " << setw(5) << lv->Eta()
-           << " phi " << setw(5) << lv->Phi()
+           << " pt " << setw(6) << m_kin.pt(SusyKinematics::JET, iJet)/GeV
+           << " eta " << setw(5) << m_kin.eta(SusyKinematics::JET, iJet)
+           << " phi " << setw(5) << m_kin.phi(SusyKinematics::JET, iJet)
            << " mv1 " << jet->flavor_weight_MV1();
       cout << endl;
     }
@@ -1295,23 +1828,22 @@ void SusyD3PDAna::dumpBaselineObjects()
 /*--------------------------------------------------------------------------------*/
 void SusyD3PDAna::dumpSignalObjects()
 {
-  uint nEle = m_sigElectrons.size();
-  uint nMu  = m_sigMuons.size();
-  //uint nTau = m_sigTaus.size();
-  uint nJet = m_sigJets.size();
+  uint nEle = sigElectrons().size();
+  uint nMu  = sigMuons().size();
+  //uint nTau = sigTaus().size();
+  uint nJet = sigJets().size();
 
   cout.precision(2);
   if(nEle){
     cout << "Signal electrons" << endl;
     for(uint i=0; i < nEle; i++){
-      int iEl = m_sigElectrons[i];
-      const TLorentzVector* lv = & m_susyObj.GetElecTLV(iEl);
+      int iEl = sigElectrons()[i];
       const ElectronElement* ele = & d3pd.ele[iEl];
       cout << "  El : " << fixed
            << " q " << setw(2) << (int) ele->charge()
-           << " pt " << setw(6) << lv->Pt()/GeV
-           << " eta " << setw(5) << lv->Eta()
-           << " phi " << setw(5) << lv->Phi();
+           << " pt " << setw(6) << m_kin.pt(SusyKinematics::ELE, iEl)/GeV
+           << " eta " << setw(5) << m_kin.eta(SusyKinematics::ELE, iEl)
+           << " phi " << setw(5) << m_kin.phi(SusyKinematics::ELE, iEl);
       if(m_isMC) cout << " type " << setw(2) << ele->type() << " origin " << setw(2) << ele->origin();
       cout << endl;
     }
@@ -1319,14 +1851,13 @@ void SusyD3PDAna::dumpSignalObjects()
   if(nMu){
     cout << "Signal muons" << endl;
     for(uint i=0; i < nMu; i++){
-      int iMu = m_sigMuons[i];
-      const TLorentzVector* lv = & m_susyObj.GetMuonTLV(iMu);
+      int iMu = sigMuons()[i];
       const MuonElement* muo = & d3pd.muo[iMu];
       cout << "  Mu : " << fixed
            << " q " << setw(2) << (int) muo->charge()
-           << " pt " << setw(6) << lv->Pt()/GeV
-           << " eta " << setw(5) << lv->Eta()
-           << " phi " << setw(5) << lv->Phi();
+           << " pt " << setw(6) << m_kin.pt(SusyKinematics::MUO, iMu)/GeV
+           << " eta " << setw(5) << m_kin.eta(SusyKinematics::MUO, iMu)
+           << " phi " << setw(5) << m_kin.phi(SusyKinematics::MUO, iMu);
       if(m_isMC) cout << " type " << setw(2) << muo->type() << " origin " << setw(2) << muo->origin();
       cout << endl;
     }
@@ -1334,13 +1865,12 @@ void SusyD3PDAna::dumpSignalObjects()
   if(nJet){
     cout << "Signal jets" << endl;
     for(uint i=0; i < nJet; i++){
-      int iJet = m_sigJets[i];
-      const TLorentzVector* lv = & m_susyObj.GetJetTLV(iJet);
+      int iJet = sigJets()[i];
       const JetElement* jet = & d3pd.jet[iJet];
       cout << "  Jet : " << fixed
-           << " pt " << setw(6) << lv->Pt()/GeV
-           << " eta " << setw(5) << lv->Eta()
-           << " phi " << setw(5) << lv->Phi()
+           << " pt " << setw(6) << m_kin.pt(SusyKinematics::JET, iJet)/GeV
+           << " eta " << setw(5) << m_kin.eta(SusyKinematics::JET, iJet)
+           << " phi " << setw(5) << m_kin.phi(SusyKinematics::JET, iJet)
            << " mv1 " << jet->flavor_weight_MV1();
       cout << endl;
     }
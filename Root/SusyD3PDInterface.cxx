@@ -1,3 +1,11 @@
+#include <fstream>
+
+#include "TFile.h"
+#include "TBranch.h"
+#include "TTreeCache.h"
+#include "TTreeCacheUnzip.h"
+#include "TTreePerfStats.h"
+
 #include "SusyCommon/SusyD3PDInterface.h"
 
 #include "MultiLep/MuonTools.h"
@@ -95,9 +103,21 @@ void SusyD3PDContainer::ReadAllActive()
 /*--------------------------------------------------------------------------------*/
 SusyD3PDInterface::SusyD3PDInterface() :
         d3pd(m_entry),
+        m_tree(0),
         m_entry(0),
+        m_progress("SusyD3PDInterface", 10000),
         m_dbg(0),
-        m_isMC(true)
+        m_isMC(true),
+        m_cacheSize(30*1024*1024),
+        m_cacheLearnEntries(100),
+        m_cacheLearning(false),
+        m_readAhead(false),
+        m_ioStats(0),
+        m_treeEntries(-1),
+        m_profileBranches(false),
+        m_profileFile(""),
+        m_manifestFile(""),
+        m_profileOwner(0)
 {
 }
 /*--------------------------------------------------------------------------------*/
@@ -105,6 +125,7 @@ SusyD3PDInterface::SusyD3PDInterface() :
 /*--------------------------------------------------------------------------------*/
 SusyD3PDInterface::~SusyD3PDInterface()
 {
+  if(m_ioStats) delete m_ioStats;
 }
 
 /*--------------------------------------------------------------------------------*/
@@ -114,7 +135,199 @@ void SusyD3PDInterface::Init(TTree* tree)
 {
   if(m_dbg) cout << "SusyD3PDInterface::Init" << endl;
   m_tree = tree;
+
+  // Start the clock of the progress reports, unless the loop already started
+  if(m_progress.entries() == 0) m_progress.start();
   d3pd.ReadFrom(tree);
+
+  // The read-ahead has to be switched on before the cache of the first file is created.
+  // TTree::SetCacheSize then builds a TTreeCacheUnzip, whose helper thread inflates
+  // the baskets of the cached branches ahead of the entry being processed.
+  if(m_readAhead && m_cacheSize > 0){
+    TTreeCacheUnzip::SetParallelUnzip(TTreeCacheUnzip::kForce);
+    cout << "SusyD3PDInterface : parallel unzip read-ahead enabled" << endl;
+  }
+  else if(m_readAhead){
+    cout << "SusyD3PDInterface : read-ahead needs the read cache, ignoring it" << endl;
+  }
+
+  // The branch status is kept by the chain for all of its files
+  if(m_manifestFile != "") applyBranchManifest();
+
+  // Monitor the reads so that the I/O wait can be reported at the end
+  if(m_ioStats) delete m_ioStats;
+  m_ioStats = new TTreePerfStats("susyD3PDIOStats", tree);
+}
+
+/*--------------------------------------------------------------------------------*/
+// Notify is called by the chain every time a new file is opened
+/*--------------------------------------------------------------------------------*/
+Bool_t SusyD3PDInterface::Notify()
+{
+  if(m_dbg) cout << "SusyD3PDInterface::Notify" << endl;
+
+  // Before the first LoadTree there is no file yet
+  if(!m_tree || !m_tree->GetTree()) return kTRUE;
+  m_treeEntries = m_tree->GetTree()->GetEntries();
+
+  if(m_cacheSize > 0) armCache();
+  if(m_ioStats) m_ioStats->SetFile(m_tree->GetCurrentFile());
+
+  return kTRUE;
+}
+
+/*--------------------------------------------------------------------------------*/
+// Setup the TTreeCache on the current file of the chain.
+// The first file runs a training phase in which ROOT records the branches that
+// are actually read with the current configuration (data/MC, sys, taus, truth...).
+// The learned branches are then registered up front for every following file.
+/*--------------------------------------------------------------------------------*/
+void SusyD3PDInterface::armCache()
+{
+  if(m_tree->GetCacheSize() != m_cacheSize) m_tree->SetCacheSize(m_cacheSize);
+
+  if(m_cacheBranches.size() == 0){
+    TTreeCache::SetLearnEntries(m_cacheLearnEntries);
+    m_cacheLearning = true;
+  }
+  else{
+    for(uint i=0; i<m_cacheBranches.size(); i++)
+      m_tree->AddBranchToCache(m_cacheBranches[i].c_str(), kFALSE);
+    m_tree->StopCacheLearningPhase();
+  }
+}
+/*--------------------------------------------------------------------------------*/
+void SusyD3PDInterface::checkCacheLearning()
+{
+  TFile* file = m_tree? m_tree->GetCurrentFile() : 0;
+  TTreeCache* cache = file? dynamic_cast<TTreeCache*>(file->GetCacheRead()) : 0;
+  if(cache == 0 || cache->IsLearning()) return;
+
+  const TObjArray* branches = cache->GetCachedBranches();
+  for(int i=0; branches && i < branches->GetEntriesFast(); i++){
+    m_cacheBranches.push_back( ((TBranch*) branches->UncheckedAt(i))->GetName() );
+  }
+  m_cacheLearning = false;
+
+  cout << "SusyD3PDInterface : TTreeCache trained on " << m_cacheBranches.size()
+       << " branches after " << m_cacheLearnEntries << " entries" << endl;
+}
+
+/*--------------------------------------------------------------------------------*/
+// Print the I/O summary
+/*--------------------------------------------------------------------------------*/
+void SusyD3PDInterface::printIOStats()
+{
+  if(!m_ioStats) return;
+  printf("\t I/O read: %.1f MB in %d calls, cache %.0f MB (%d branches) \n",
+         m_ioStats->GetBytesRead()/1024./1024., m_ioStats->GetReadCalls(),
+         m_cacheSize/1024./1024., (int) m_cacheBranches.size());
+  printf("\t I/O wait [s]: disk %.2f, unzip %.2f%s         \n",
+         m_ioStats->GetDiskTime(), m_ioStats->GetUnzipTime(),
+         m_readAhead? " (read-ahead)" : "");
+}
+
+/*--------------------------------------------------------------------------------*/
+// Branch usage profiling.
+// A branch that has been read at least once has a valid read entry. The tree is
+// deleted by the chain when moving to the next file, so the usage is collected
+// after the last entry of each tree is processed (endEntry), after each block of
+// ProcessBatch and once more in Terminate for partial trees.
+/*--------------------------------------------------------------------------------*/
+void SusyD3PDInterface::recordBranchUsage()
+{
+  TTree* tree = m_tree? m_tree->GetTree() : 0;
+  if(tree == 0) return;
+
+  TObjArray* branches = tree->GetListOfBranches();
+  for(int i=0; i < branches->GetEntriesFast(); i++){
+    TBranch* branch = (TBranch*) branches->UncheckedAt(i);
+    if(branch->GetReadEntry() != -1) m_usedBranches.insert(branch->GetName());
+  }
+}
+/*--------------------------------------------------------------------------------*/
+void SusyD3PDInterface::resetBranchUsage()
+{
+  m_cacheBranches.clear();
+  m_cacheLearning = false;
+  m_usedBranches.clear();
+}
+/*--------------------------------------------------------------------------------*/
+void SusyD3PDInterface::applyBranchManifest()
+{
+  vector<string> branches;
+  string config;
+  if(!readBranchManifest(m_manifestFile, branches, &config)){
+    cout << "SusyD3PDInterface::applyBranchManifest ERROR - cannot read " << m_manifestFile << endl;
+    abort();
+  }
+
+  // Branches missing from the manifest would silently read stale values
+  if(config == ""){
+    cout << "SusyD3PDInterface::applyBranchManifest WARNING - no profiling configuration in "
+         << m_manifestFile << ", it can not be checked against this job (" << branchConfig() << ")" << endl;
+  }
+  else if(config != branchConfig()){
+    cout << "SusyD3PDInterface::applyBranchManifest ERROR - " << m_manifestFile << " was profiled with "
+         << config << ", this job runs with " << branchConfig() << endl;
+    abort();
+  }
+
+  m_tree->SetBranchStatus("*", 0);
+  uint nEnabled = 0;
+  for(uint i=0; i<branches.size(); i++){
+    if(m_tree->GetBranch(branches[i].c_str()) == 0){
+      cout << "SusyD3PDInterface::applyBranchManifest WARNING - branch " << branches[i]
+           << " not found in input" << endl;
+      continue;
+    }
+    m_tree->SetBranchStatus(branches[i].c_str(), 1);
+    nEnabled++;
+  }
+  cout << "SusyD3PDInterface : enabled " << nEnabled << " branches from manifest "
+       << m_manifestFile << endl;
+}
+/*--------------------------------------------------------------------------------*/
+bool SusyD3PDInterface::readBranchManifest(string fileName, vector<string>& branches, string* config)
+{
+  ifstream in(fileName.c_str());
+  if(!in.is_open()) return false;
+
+  const string configTag = "# config: ";
+  string line;
+  while(getline(in, line)){
+    if(config && line.compare(0, configTag.size(), configTag) == 0){
+      size_t last = line.find_last_not_of(" \t\r");
+      *config = line.substr(configTag.size(), last+1-configTag.size());
+      continue;
+    }
+    // strip comments and whitespace
+    size_t comment = line.find('#');
+    if(comment != string::npos) line.erase(comment);
+    size_t first = line.find_first_not_of(" \t\r");
+    if(first == string::npos) continue;
+    size_t last = line.find_last_not_of(" \t\r");
+    branches.push_back(line.substr(first, last-first+1));
+  }
+  return true;
+}
+/*--------------------------------------------------------------------------------*/
+bool SusyD3PDInterface::writeBranchManifest(string fileName, const set<string>& branches, string config)
+{
+  ofstream out(fileName.c_str());
+  if(!out.is_open()) return false;
+
+  out << "# SusyCommon branch manifest - " << branches.size() << " branches" << endl;
+  if(config != "") out << "# config: " << config << endl;
+  for(set<string>::const_iterator it = branches.begin(); it != branches.end(); ++it)
+    out << *it << endl;
+  return true;
+}
+
+/*--------------------------------------------------------------------------------*/
+string SusyD3PDInterface::branchConfig()
+{
+  return m_isMC? "mc=1" : "mc=0";
 }
 
 /*--------------------------------------------------------------------------------*/
@@ -127,6 +340,26 @@ void SusyD3PDInterface::Begin(TTree* /*tree*/)
   if(m_dbg) cout << "SusyD3PDInterface::Begin" << endl;
 }
 
+/*--------------------------------------------------------------------------------*/
+// Process a block of entries of the current tree
+/*--------------------------------------------------------------------------------*/
+Long64_t SusyD3PDInterface::ProcessBatch(Long64_t firstEntry, Long64_t nEntries)
+{
+  // Keep the chain read entry up to date, as TTreePlayer does, since the
+  // selectors use it to know where they are in the chain
+  Long64_t chainOffset = m_tree->GetReadEntry() - firstEntry;
+  Long64_t nProcessed = 0;
+  for(Long64_t entry = firstEntry; entry < firstEntry + nEntries; entry++){
+    if(GetAbort() != kContinue) break;
+    if(entry != firstEntry) m_tree->LoadTree(chainOffset + entry);
+    if(!Process(entry)) break;
+    nProcessed++;
+  }
+  // The next block of this selector may be in another tree
+  if(m_profileBranches) recordBranchUsage();
+  return nProcessed;
+}
+
 /*--------------------------------------------------------------------------------*/
 // Main process loop function - This is just an example for testing
 /*--------------------------------------------------------------------------------*/
@@ -137,11 +370,10 @@ Bool_t SusyD3PDInterface::Process(Long64_t entry)
 
   if(m_dbg) cout << "____________________________________________________________" << endl;
 
-  static Long64_t chainEntry = -1;
-  chainEntry++;
-  if(m_dbg || chainEntry%10000==0)
+  m_progress.count();
+  if(m_dbg)
   {
-    cout << "**** Processing entry " << setw(6) << chainEntry 
+    cout << "**** Processing entry " << setw(6) << m_progress.entries() 
          << " run " << setw(6) << d3pd.evt.RunNumber()
          << " event " << setw(7) << d3pd.evt.EventNumber() << " ****" << endl;
   }
@@ -181,6 +413,7 @@ Bool_t SusyD3PDInterface::Process(Long64_t entry)
     }
   }
 
+  endEntry();
   return kTRUE;
 }
 
@@ -192,6 +425,22 @@ Bool_t SusyD3PDInterface::Process(Long64_t entry)
 void SusyD3PDInterface::Terminate()
 {
   if(m_dbg) cout << "SusyD3PDInterface::Terminate" << endl;
+
+  m_progress.summary();
+
+  if(m_profileBranches){
+    recordBranchUsage();
+    if(m_profileOwner){
+      m_profileOwner->m_usedBranches.insert(m_usedBranches.begin(), m_usedBranches.end());
+      return;
+    }
+    if(!writeBranchManifest(m_profileFile, m_usedBranches, branchConfig())){
+      cout << "SusyD3PDInterface::Terminate ERROR - cannot write " << m_profileFile << endl;
+      abort();
+    }
+    cout << "Branch manifest with " << m_usedBranches.size() << " branches saved to "
+         << m_profileFile << endl;
+  }
 }
 
 #undef GeV
@@ -7,6 +7,10 @@ using namespace std;
 /*--------------------------------------------------------------------------------*/
 SusyD3PDSkimmer::SusyD3PDSkimmer()
 {
+  m_progress.setName("SusyD3PDSkimmer");
+  m_progress.setInterval(5000);
+  m_progress.setCountPass();
+
   m_nBaseLepMin = 3;
   m_nSigLepMin = 3;
 
@@ -65,11 +69,10 @@ Bool_t SusyD3PDSkimmer::Process(Long64_t entry)
   // Communicate the entry number to the interface objects
   GetEntry(entry);
 
-  static Long64_t chainEntry = -1;
-  chainEntry++;
-  if(m_dbg || chainEntry%5000==0)
+  m_progress.count();
+  if(m_dbg)
   {
-    cout << "**** Processing entry " << setw(6) << chainEntry
+    cout << "**** Processing entry " << setw(6) << m_progress.entries()
          << " run " << setw(6) << d3pd.evt.RunNumber()
          << " event " << setw(7) << d3pd.evt.EventNumber() << " ****" << endl;
   }
@@ -84,8 +87,10 @@ Bool_t SusyD3PDSkimmer::Process(Long64_t entry)
     // save event to output
     d3pd.ReadAllActive();
     m_outputTree->Fill();
+    m_progress.pass();
   }
 
+  endEntry();
   return kTRUE;
 }
 
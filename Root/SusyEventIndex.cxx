@@ -0,0 +1,197 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+#include "TFile.h"
+#include "TBranch.h"
+#include "TChainElement.h"
+#include "TSystem.h"
+
+#include "SusyCommon/SusyEventIndex.h"
+#include "SusyCommon/SusyAtomicFile.h"
+
+using namespace std;
+
+// Magic of the index files, changed when the format changes
+static const char INDEX_MAGIC[8] = { 'E', 'V', 'T', 'I', 'D', 'X', '0', '1' };
+
+/*--------------------------------------------------------------------------------*/
+// SusyEventIndex Constructor
+/*--------------------------------------------------------------------------------*/
+SusyEventIndex::SusyEventIndex(string indexDir) :
+        m_indexDir(indexDir),
+        m_nRead(0),
+        m_nBuilt(0)
+{
+}
+
+/*--------------------------------------------------------------------------------*/
+// Chain entries of a pick list
+/*--------------------------------------------------------------------------------*/
+TEventList* SusyEventIndex::pickEntries(TChain* chain, string pickFile)
+{
+  ifstream in(pickFile.c_str());
+  if(!in.is_open()){
+    cout << "SusyEventIndex::pickEntries ERROR - cannot open pick list " << pickFile << endl;
+    return 0;
+  }
+  vector<Record> picks;
+  string line;
+  int lineNumber = 0;
+  while(getline(in, line)){
+    lineNumber++;
+    size_t first = line.find_first_not_of(" \t\r");
+    if(first == string::npos || line[first] == '#') continue;
+    stringstream stream(line);
+    Record pick;
+    if(!(stream >> pick.run >> pick.event)){
+      cout << "SusyEventIndex::pickEntries ERROR - bad line " << lineNumber << " in " << pickFile
+           << ", expected: run event" << endl;
+      return 0;
+    }
+    pick.entry = -1;
+    picks.push_back(pick);
+  }
+
+  // Look for the picks in each file, the chain entries of a file start after
+  // the entries of the previous ones
+  TEventList* list = new TEventList("pickList", pickFile.c_str());
+  vector<bool> found(picks.size(), false);
+  Long64_t offset = 0;
+  TObjArray* files = chain->GetListOfFiles();
+  for(int iFile=0; iFile<files->GetEntries(); iFile++){
+    TChainElement* element = (TChainElement*) files->At(iFile);
+    string fileName = element->GetTitle();
+    vector<Record> records;
+    if(getIndex(fileName, chain->GetName(), records)){
+      delete list;
+      return 0;
+    }
+    Long64_t nEntries = records.size();
+    if(element->GetEntries() != TChain::kBigNumber && element->GetEntries() != nEntries){
+      cout << "SusyEventIndex::pickEntries ERROR - index of " << fileName << " has " << nEntries
+           << " entries, the chain " << element->GetEntries() << endl;
+      delete list;
+      return 0;
+    }
+
+    for(uint iPick=0; iPick<picks.size(); iPick++){
+      pair<vector<Record>::iterator, vector<Record>::iterator> range =
+        equal_range(records.begin(), records.end(), picks[iPick]);
+      for(vector<Record>::iterator it = range.first; it != range.second; ++it){
+        list->Enter(offset + it->entry);
+        found[iPick] = true;
+        cout << "  run " << it->run << " event " << it->event << " : entry " << offset + it->entry
+             << " (" << it->entry << " in " << fileName << ")" << endl;
+      }
+    }
+    offset += nEntries;
+  }
+
+  int nMissing = 0;
+  for(uint iPick=0; iPick<picks.size(); iPick++){
+    if(found[iPick]) continue;
+    cout << "SusyEventIndex::pickEntries WARNING - run " << picks[iPick].run << " event "
+         << picks[iPick].event << " not found in the input files" << endl;
+    nMissing++;
+  }
+  cout << "SusyEventIndex : " << m_nRead << " indices read, " << m_nBuilt << " built, "
+       << list->GetN() << " entries picked, " << nMissing << " events not found" << endl;
+  return list;
+}
+
+/*--------------------------------------------------------------------------------*/
+// Index of one file
+/*--------------------------------------------------------------------------------*/
+int SusyEventIndex::getIndex(string fileName, string treeName, vector<Record>& records)
+{
+  // Remote files can not be checked, their index is used as long as it exists
+  FileStat_t stat;
+  bool isLocal = gSystem->GetPathInfo(fileName.c_str(), stat) == 0;
+  Long64_t size  = isLocal? stat.fSize : 0;
+  Long64_t mtime = isLocal? stat.fMtime : 0;
+
+  string indexFile = indexFileName(fileName);
+  ifstream in(indexFile.c_str(), ios::binary);
+  if(in.is_open()){
+    Header header;
+    in.read((char*) &header, sizeof(Header));
+    if(in && memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0 &&
+       (!isLocal || (header.size == size && header.mtime == mtime))){
+      records.resize(header.entries);
+      if(header.entries > 0) in.read((char*) &records[0], header.entries * sizeof(Record));
+      if(in){
+        m_nRead++;
+        return 0;
+      }
+    }
+    in.close();
+  }
+
+  if(buildIndex(fileName, treeName, records)) return 1;
+  m_nBuilt++;
+
+  SusyAtomicFile file(indexFile, true);
+  if(file.isOpen()){
+    Header header;
+    memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header.size    = size;
+    header.mtime   = mtime;
+    header.entries = records.size();
+    ofstream& out = file.stream();
+    out.write((const char*) &header, sizeof(Header));
+    if(header.entries > 0) out.write((const char*) &records[0], header.entries * sizeof(Record));
+  }
+  if(file.commit()){
+    cout << "SusyEventIndex::getIndex WARNING - cannot write " << indexFile
+         << ", the index is not saved" << endl;
+  }
+  return 0;
+}
+/*--------------------------------------------------------------------------------*/
+string SusyEventIndex::indexFileName(string fileName)
+{
+  if(m_indexDir == "") return fileName + ".evtidx";
+
+  // Files of different datasets may have the same name
+  stringstream name;
+  name << m_indexDir << "/" << gSystem->BaseName(fileName.c_str()) << "_"
+       << hex << TString(fileName.c_str()).Hash() << ".evtidx";
+  return name.str();
+}
+/*--------------------------------------------------------------------------------*/
+int SusyEventIndex::buildIndex(string fileName, string treeName, vector<Record>& records)
+{
+  TFile* file = TFile::Open(fileName.c_str());
+  TTree* tree = file? (TTree*) file->Get(treeName.c_str()) : 0;
+  TBranch* runBranch   = tree? tree->GetBranch("RunNumber") : 0;
+  TBranch* eventBranch = tree? tree->GetBranch("EventNumber") : 0;
+  if(runBranch == 0 || eventBranch == 0){
+    cout << "SusyEventIndex::buildIndex ERROR - no tree " << treeName
+         << " with RunNumber and EventNumber in " << fileName << endl;
+    if(file) file->Close();
+    delete file;
+    return 1;
+  }
+
+  // Only the baskets of the two branches are read
+  UInt_t run = 0, event = 0;
+  runBranch->SetAddress(&run);
+  eventBranch->SetAddress(&event);
+  Long64_t nEntries = tree->GetEntries();
+  records.resize(nEntries);
+  for(Long64_t entry=0; entry<nEntries; entry++){
+    runBranch->GetEntry(entry);
+    eventBranch->GetEntry(entry);
+    records[entry].run   = run;
+    records[entry].event = event;
+    records[entry].entry = entry;
+  }
+  file->Close();
+  delete file;
+
+  stable_sort(records.begin(), records.end());
+  return 0;
+}
@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+#include "TSystem.h"
+
+#include "GoodRunsLists/TGoodRunsList.h"
+#include "GoodRunsLists/TGoodRunsListReader.h"
+
+#include "SusyCommon/SusyGoodRunsList.h"
+#include "SusyCommon/SusyAtomicFile.h"
+
+using namespace std;
+
+// Cache file format: magic, version, XML size and mtime, array sizes, then the arrays
+static const char  GRL_CACHE_MAGIC[4] = { 'S', 'G', 'R', 'L' };
+static const int   GRL_CACHE_VERSION  = 1;
+
+/*--------------------------------------------------------------------------------*/
+// SusyGoodRunsList Constructor
+/*--------------------------------------------------------------------------------*/
+SusyGoodRunsList::SusyGoodRunsList()
+{
+  clear();
+}
+/*--------------------------------------------------------------------------------*/
+void SusyGoodRunsList::clear()
+{
+  m_runs.clear();
+  m_runOffsets.assign(1, 0);
+  m_lbBegin.clear();
+  m_lbEnd.clear();
+}
+
+/*--------------------------------------------------------------------------------*/
+// Load the GRL, from the cache when it matches the XML
+/*--------------------------------------------------------------------------------*/
+int SusyGoodRunsList::load(string xmlFile)
+{
+  FileStat_t stat;
+  if(gSystem->GetPathInfo(xmlFile.c_str(), stat) != 0){
+    cout << "SusyGoodRunsList::load ERROR - cannot find " << xmlFile << endl;
+    return 1;
+  }
+
+  string cacheFile = xmlFile + ".bin";
+  if(readCache(cacheFile, stat.fSize, stat.fMtime) == 0){
+    cout << "SusyGoodRunsList::load - " << nRuns() << " runs, " << nIntervals()
+         << " lumi block intervals from " << cacheFile << endl;
+    return 0;
+  }
+
+  if(compile(xmlFile)) return 1;
+  cout << "SusyGoodRunsList::load - " << nRuns() << " runs, " << nIntervals()
+       << " lumi block intervals from " << xmlFile << endl;
+
+  // Not fatal, the compiled list is used for this job anyway
+  if(writeCache(cacheFile, stat.fSize, stat.fMtime))
+    cout << "SusyGoodRunsList::load WARNING - the GRL cache is not saved" << endl;
+  return 0;
+}
+
+/*--------------------------------------------------------------------------------*/
+// Lookups
+/*--------------------------------------------------------------------------------*/
+int SusyGoodRunsList::findRun(uint run) const
+{
+  vector<uint>::const_iterator it = lower_bound(m_runs.begin(), m_runs.end(), run);
+  if(it == m_runs.end() || *it != run) return -1;
+  return it - m_runs.begin();
+}
+/*--------------------------------------------------------------------------------*/
+bool SusyGoodRunsList::hasRunLumiBlock(uint run, uint lb) const
+{
+  int iRun = findRun(run);
+  if(iRun < 0) return false;
+
+  // Last interval starting at or before lb
+  vector<uint>::const_iterator first = m_lbBegin.begin() + m_runOffsets[iRun];
+  vector<uint>::const_iterator last  = m_lbBegin.begin() + m_runOffsets[iRun+1];
+  vector<uint>::const_iterator it    = upper_bound(first, last, lb);
+  if(it == first) return false;
+  return lb <= m_lbEnd[it - m_lbBegin.begin() - 1];
+}
+
+/*--------------------------------------------------------------------------------*/
+// Parse the XML, the intervals of each run are sorted and the overlaps merged
+/*--------------------------------------------------------------------------------*/
+int SusyGoodRunsList::compile(string xmlFile)
+{
+  Root::TGoodRunsListReader reader;
+  reader.AddXMLFile(xmlFile.c_str());
+  if(!reader.Interpret()){
+    cout << "SusyGoodRunsList::compile ERROR - cannot interpret " << xmlFile << endl;
+    return 1;
+  }
+  Root::TGoodRunsList grl = reader.GetMergedGoodRunsList();
+
+  clear();
+  // The list is a map, so the runs come sorted
+  for(Root::TGoodRunsList::const_iterator runIt = grl.begin(); runIt != grl.end(); ++runIt){
+    const Root::TGoodRun& goodRun = runIt->second;
+    vector< pair<uint,uint> > ranges;
+    for(Root::TGoodRun::const_iterator lbIt = goodRun.begin(); lbIt != goodRun.end(); ++lbIt){
+      if(lbIt->End() < lbIt->Begin()) continue;
+      ranges.push_back(make_pair((uint)lbIt->Begin(), (uint)lbIt->End()));
+    }
+    if(ranges.empty()) continue;
+    sort(ranges.begin(), ranges.end());
+
+    m_runs.push_back(runIt->first);
+    uint begin = ranges[0].first;
+    uint end   = ranges[0].second;
+    for(uint i=1; i<ranges.size(); i++){
+      if(ranges[i].first <= end + 1){
+        end = max(end, ranges[i].second);
+        continue;
+      }
+      m_lbBegin.push_back(begin);
+      m_lbEnd.push_back(end);
+      begin = ranges[i].first;
+      end   = ranges[i].second;
+    }
+    m_lbBegin.push_back(begin);
+    m_lbEnd.push_back(end);
+    m_runOffsets.push_back(m_lbBegin.size());
+  }
+  return 0;
+}
+
+/*--------------------------------------------------------------------------------*/
+// Binary cache
+/*--------------------------------------------------------------------------------*/
+template<class T> static bool readValue(ifstream& in, T& value)
+{
+  return in.read((char*) &value, sizeof(T)).good();
+}
+template<class T> static bool readArray(ifstream& in, vector<T>& values, uint n)
+{
+  values.resize(n);
+  return n == 0 || in.read((char*) &values[0], n * sizeof(T)).good();
+}
+template<class T> static void writeValue(ofstream& out, const T& value)
+{
+  out.write((const char*) &value, sizeof(T));
+}
+template<class T> static void writeArray(ofstream& out, const vector<T>& values)
+{
+  if(!values.empty()) out.write((const char*) &values[0], values.size() * sizeof(T));
+}
+/*--------------------------------------------------------------------------------*/
+int SusyGoodRunsList::readCache(string cacheFile, Long64_t xmlSize, Long_t xmlMtime)
+{
+  ifstream in(cacheFile.c_str(), ios::binary);
+  if(!in.is_open()) return 1;
+
+  char magic[4];
+  int version;
+  Long64_t size, mtime;
+  uint nRun, nInterval;
+  if(!in.read(magic, 4) || !equal(magic, magic + 4, GRL_CACHE_MAGIC)) return 1;
+  if(!readValue(in, version) || version != GRL_CACHE_VERSION) return 1;
+  if(!readValue(in, size) || !readValue(in, mtime)) return 1;
+  if(size != xmlSize || mtime != (Long64_t) xmlMtime) return 1;
+  if(!readValue(in, nRun) || !readValue(in, nInterval)) return 1;
+
+  if(!readArray(in, m_runs, nRun) || !readArray(in, m_runOffsets, nRun + 1) ||
+     !readArray(in, m_lbBegin, nInterval) || !readArray(in, m_lbEnd, nInterval) ||
+     m_runOffsets[nRun] != nInterval){
+    cout << "SusyGoodRunsList::readCache WARNING - " << cacheFile << " is corrupted, rebuilding it" << endl;
+    clear();
+    return 1;
+  }
+  return 0;
+}
+/*--------------------------------------------------------------------------------*/
+int SusyGoodRunsList::writeCache(string cacheFile, Long64_t xmlSize, Long_t xmlMtime)
+{
+  SusyAtomicFile file(cacheFile, true);
+  if(!file.isOpen()){
+    cout << "SusyGoodRunsList::writeCache ERROR - cannot write " << file.tmpName() << endl;
+    return 1;
+  }
+  ofstream& out = file.stream();
+  Long64_t mtime = xmlMtime;
+  uint nRun = m_runs.size();
+  uint nInterval = m_lbBegin.size();
+  out.write(GRL_CACHE_MAGIC, 4);
+  writeValue(out, GRL_CACHE_VERSION);
+  writeValue(out, xmlSize);
+  writeValue(out, mtime);
+  writeValue(out, nRun);
+  writeValue(out, nInterval);
+  writeArray(out, m_runs);
+  writeArray(out, m_runOffsets);
+  writeArray(out, m_lbBegin);
+  writeArray(out, m_lbEnd);
+  if(file.commit()){
+    cout << "SusyGoodRunsList::writeCache ERROR - cannot write " << cacheFile << endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,77 @@
+#include "TMath.h"
+#include "TVector2.h"
+
+#include "SusyCommon/SusyKinematics.h"
+
+using namespace std;
+
+/*--------------------------------------------------------------------------------*/
+// Empty the collections
+/*--------------------------------------------------------------------------------*/
+void SusyKinematics::clear()
+{
+  for(int c=0; c<N_COLLECTIONS; c++) reset((Collection) c, 0);
+}
+/*--------------------------------------------------------------------------------*/
+void SusyKinematics::reset(Collection c, uint n)
+{
+  Table& t = m_tables[c];
+  t.pt.resize(n);
+  t.eta.resize(n);
+  t.phi.resize(n);
+  t.e.resize(n);
+  t.m.resize(n);
+  t.px.resize(n);
+  t.py.resize(n);
+  t.pz.resize(n);
+  t.cosPhi.resize(n);
+  t.sinPhi.resize(n);
+  t.q.resize(n);
+  t.filled.assign(n, 0);
+}
+
+/*--------------------------------------------------------------------------------*/
+// Fill one object, growing the collection if needed
+/*--------------------------------------------------------------------------------*/
+void SusyKinematics::fill(Collection c, uint i, const TLorentzVector& lv, float q)
+{
+  Table& t = m_tables[c];
+  if(i >= t.filled.size()){
+    uint n = i + 1;
+    t.pt.resize(n);
+    t.eta.resize(n);
+    t.phi.resize(n);
+    t.e.resize(n);
+    t.m.resize(n);
+    t.px.resize(n);
+    t.py.resize(n);
+    t.pz.resize(n);
+    t.cosPhi.resize(n);
+    t.sinPhi.resize(n);
+    t.q.resize(n);
+    t.filled.resize(n, 0);
+  }
+  double pt   = lv.Pt();
+  t.pt[i]     = pt;
+  t.eta[i]    = lv.Eta();
+  t.phi[i]    = lv.Phi();
+  t.e[i]      = lv.E();
+  t.m[i]      = lv.M();
+  t.px[i]     = lv.Px();
+  t.py[i]     = lv.Py();
+  t.pz[i]     = lv.Pz();
+  t.cosPhi[i] = pt > 0? lv.Px() / pt : 1;
+  t.sinPhi[i] = pt > 0? lv.Py() / pt : 0;
+  t.q[i]      = q;
+  t.filled[i] = 1;
+}
+
+/*--------------------------------------------------------------------------------*/
+// Same as TLorentzVector::DeltaR
+/*--------------------------------------------------------------------------------*/
+double SusyKinematics::deltaR(Collection c, uint i, double eta, double phi) const
+{
+  double dEta = m_tables[c].eta[i] - eta;
+  double dPhi = TVector2::Phi_mpi_pi(m_tables[c].phi[i] - phi);
+  return TMath::Sqrt(dEta*dEta + dPhi*dPhi);
+}
@@ -15,6 +15,10 @@ const bool dumpMet = false;
 /*--------------------------------------------------------------------------------*/
 SusyMetValidation::SusyMetValidation()
 {
+  m_progress.setName("SusyMetValidation");
+  m_progress.setInterval(5000);
+  m_progress.setCountPass();
+
   // Met names
   metNames[Met_susy_stvf] = "susy_stvf";
   metNames[Met_d3pd_stvf] = "d3pd_stvf";
@@ -88,11 +92,10 @@ Bool_t SusyMetValidation::Process(Long64_t entry)
   // Communicate the entry number to the interface objects
   GetEntry(entry);
 
-  static Long64_t chainEntry = -1;
-  chainEntry++;
-  if(m_dbg || chainEntry%5000==0)
+  m_progress.count();
+  if(m_dbg)
   {
-    cout << "**** Processing entry " << setw(6) << chainEntry
+    cout << "**** Processing entry " << setw(6) << m_progress.entries()
          << " run " << setw(6) << d3pd.evt.RunNumber()
          << " event " << setw(7) << d3pd.evt.EventNumber() << " ****" << endl;
   }
@@ -101,8 +104,10 @@ Bool_t SusyMetValidation::Process(Long64_t entry)
   if(selectEvent()){
     d3pd.ReadAllActive();
     m_outputTree->Fill();
+    m_progress.pass();
   }
 
+  endEntry();
   return kTRUE;
 }
 
@@ -306,20 +311,20 @@ bool SusyMetValidation::selectEvent()
   if((m_cutFlags & ECut_Cosmic) == 0) return false;
   n_evt_cosmic++;
   
-  n_base_ele += m_baseElectrons.size();
-  n_base_muo += m_baseMuons.size();
-  n_base_tau += m_baseTaus.size();
-  n_base_jet += m_baseJets.size();
-  n_sig_ele += m_sigElectrons.size();
-  n_sig_muo += m_sigMuons.size();
-  n_sig_tau += m_sigTaus.size();
-  n_sig_jet += m_sigJets.size();
+  n_base_ele += baseElectrons().size();
+  n_base_muo += baseMuons().size();
+  n_base_tau += baseTaus().size();
+  n_base_jet += baseJets().size();
+  n_sig_ele += sigElectrons().size();
+  n_sig_muo += sigMuons().size();
+  n_sig_tau += sigTaus().size();
+  n_sig_jet += sigJets().size();
   
 
   // Lepton multiplicity
-  //uint nBaseLep = m_baseElectrons.size() + m_baseMuons.size();
-  //uint nSigEle = m_sigElectrons.size();
-  uint nSigMuo = m_sigMuons.size();
+  //uint nBaseLep = baseElectrons().size() + baseMuons().size();
+  //uint nSigEle = sigElectrons().size();
+  uint nSigMuo = sigMuons().size();
   //uint nSigLep = nSigEle + nSigMuo;
   //if(nBaseLep != 3) return false;
   //if(nSigLep != 3) return false;
@@ -334,9 +339,7 @@ bool SusyMetValidation::selectEvent()
   n_evt_sfos++;
 
   // Z mass
-  static vector<float> msfos;
-  msfos.clear();
-  msfos = MassesOfSFOSPairs(m_susyObj, &d3pd.muo, m_sigMuons, &d3pd.ele, m_sigElectrons);
+  vector<float> msfos = MassesOfSFOSPairs(m_susyObj, &d3pd.muo, sigMuons(), &d3pd.ele, sigElectrons());
   bool hasZ = false;
   for(uint i=0; i<msfos.size(); i++){
     if(fabs(msfos[i]-91.2*GeV) < 10*GeV){
@@ -352,11 +355,11 @@ bool SusyMetValidation::selectEvent()
   n_evt_met++;
 
   // Bjet veto
-  //if(IsBJetEvent(m_susyObj, &d3pd.jet, m_sigJets, SUSYBTagger::MV1, make_pair("0_122", 0.122))) return false;
+  //if(IsBJetEvent(m_susyObj, &d3pd.jet, sigJets(), SUSYBTagger::MV1, make_pair("0_122", 0.122))) return false;
   n_evt_bJet++;
 
   // Mt
-  //float mt = getMt(m_susyObj, &d3pd.muo, m_sigMuons, &d3pd.ele, m_sigElectrons, 
+  //float mt = getMt(m_susyObj, &d3pd.muo, sigMuons(), &d3pd.ele, sigElectrons(), 
                    //m_met.Vect().XYvector(), m_met.Et());
   //if(mt < 50*GeV || mt > 110*GeV) return false;
   n_evt_mt++;
@@ -366,7 +369,7 @@ bool SusyMetValidation::selectEvent()
   n_evt_lepPt++;
 
   // Select emm and mmm channels by requiring at least 2 muons
-  //if(m_sigMuons.size() < 2) return false;
+  //if(sigMuons().size() < 2) return false;
   n_evt_2mu++;
 
   // Get the event weight
@@ -375,7 +378,7 @@ bool SusyMetValidation::selectEvent()
   float lepSF = getLepSF(m_sigLeptons);
   n_evt_lepSF += lepSF;
   // B-tag eff SF
-  float bTagSF = getBTagSF(m_sigJets);
+  float bTagSF = getBTagSF(sigJets());
   n_evt_bTagSF += bTagSF;
   // Full weight
   float wTotal = w * lepSF * bTagSF;
@@ -538,9 +541,11 @@ bool SusyMetValidation::selectEvent()
 
   // susy_stvf met
   // Use the preMuons for the susy_stvf met, and all weights are 1
-  for(uint i=0; i<m_preMuons.size(); i++){
+  for(uint i=0; i<preMuons().size(); i++){
 
-    const TLorentzVector* muLV = & m_susyObj.GetMuonTLV(m_preMuons[i]);
+    int iMu = preMuons()[i];
+    double muPt  = m_kin.pt(SusyKinematics::MUO, iMu);
+    double muEta = m_kin.eta(SusyKinematics::MUO, iMu);
 
     // muon met weights - I think these three are identical
     h_muWet[Met_susy_stvf]->Fill(1, w);
@@ -548,14 +553,14 @@ bool SusyMetValidation::selectEvent()
     h_muWpy[Met_susy_stvf]->Fill(1, w);
 
     // muon kinematics
-    h_metMuPt[Met_susy_stvf]->Fill(muLV->Pt()/GeV, w);
-    h_metLepPt[Met_susy_stvf]->Fill(muLV->Pt()/GeV, w);
-    h_metMuEta[Met_susy_stvf]->Fill(muLV->Eta(), w);
-    h_metLepEta[Met_susy_stvf]->Fill(muLV->Eta(), w);
+    h_metMuPt[Met_susy_stvf]->Fill(muPt/GeV, w);
+    h_metLepPt[Met_susy_stvf]->Fill(muPt/GeV, w);
+    h_metMuEta[Met_susy_stvf]->Fill(muEta, w);
+    h_metLepEta[Met_susy_stvf]->Fill(muEta, w);
 
   }
 
-  h_nMetMu[Met_susy_stvf]->Fill(m_preMuons.size(), w);
+  h_nMetMu[Met_susy_stvf]->Fill(preMuons().size(), w);
 
   // Use d3pd muons for the d3pd_* met, with d3pd weights
   // Each weight is a vector, but perhaps only one entry?
@@ -616,19 +621,19 @@ bool SusyMetValidation::selectEvent()
 bool SusyMetValidation::passTrigger()
 {
   // Vectors of the signal leptons
-  static vector<TLorentzVector> elLVs;
-  static vector<TLorentzVector> muLVs;
-  elLVs.clear();
-  muLVs.clear();
-  for(uint iEl=0; iEl<m_sigElectrons.size(); iEl++){
-    elLVs.push_back(m_susyObj.GetElecTLV(m_sigElectrons[iEl]));
+  vector<TLorentzVector> elLVs;
+  vector<TLorentzVector> muLVs;
+  for(uint iEl=0; iEl<sigElectrons().size(); iEl++){
+    elLVs.push_back(m_susyObj.GetElecTLV(sigElectrons()[iEl]));
   }
-  for(uint iMu=0; iMu<m_sigMuons.size(); iMu++){
-    muLVs.push_back(m_susyObj.GetMuonTLV(m_sigMuons[iMu]));
+  for(uint iMu=0; iMu<sigMuons().size(); iMu++){
+    muLVs.push_back(m_susyObj.GetMuonTLV(sigMuons()[iMu]));
   }
   string stream = streamName(m_stream);
   if(stream == "Egamma") stream = "EGamma";
-  return m_triggerMatch->passesMultiLepTrigger(&elLVs, &muLVs, m_sigElectrons, m_sigMuons,
+  // passesMultiLepTrigger takes non-const lists
+  vector<int> sigEle = sigElectrons(), sigMuo = sigMuons();
+  return m_triggerMatch->passesMultiLepTrigger(&elLVs, &muLVs, sigEle, sigMuo,
                                                !m_isMC, d3pd.evt.RunNumber(), stream,
                                                d3pd.trig.trig_EF_el_n(), d3pd.trig.trig_EF_el_px(), 
                                                d3pd.trig.trig_EF_el_py(), 
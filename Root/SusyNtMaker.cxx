@@ -8,6 +8,11 @@
 #include "MultiLep/SusyGridCrossSectionTools.h"
 #include "MultiLep/TruthTools.h"
 
+#include <ctime>
+
+#include "TVirtualMutex.h"
+#include "TParameter.h"
+
 #include "SusyCommon/SusyNtMaker.h"
 #include "SusyNtuple/SusyNtTools.h"
 #include "SusyNtuple/WhTruthExtractor.h"
@@ -22,15 +27,38 @@ namespace smc =susy::mc;
 /*--------------------------------------------------------------------------------*/
 // SusyNtMaker Constructor
 /*--------------------------------------------------------------------------------*/
-SusyNtMaker::SusyNtMaker() : m_fillNt(true),
+SusyNtMaker::SusyNtMaker() : m_outFileName("susyNt.root"),
+                             m_fillNt(true),
                              m_filter(true),
                              m_nLepFilter(0),
                              m_nLepTauFilter(2),
                              m_filterTrigger(false),
                              m_saveContTaus(false),
                              m_isHsignalSample(false),
+                             m_isPowhegLfvHsignalSample(false),
                              m_hDecay(0),
-                             m_hasSusyProp(false)
+                             m_hasSusyProp(false),
+                             m_recoTruthMatchReady(false),
+                             m_checkpointEntries(0),
+                             m_deadline(0),
+                             m_startTime(0),
+                             m_lastEntry(-1)
+{
+  m_progress.setName("SusyNtMaker");
+  m_progress.setInterval(5000);
+  m_progress.setCountPass();
+  resetCounters();
+}
+/*--------------------------------------------------------------------------------*/
+// Destructor
+/*--------------------------------------------------------------------------------*/
+SusyNtMaker::~SusyNtMaker()
+{
+}
+/*--------------------------------------------------------------------------------*/
+// Reset the object and event counters, at the start of each sample
+/*--------------------------------------------------------------------------------*/
+void SusyNtMaker::resetCounters()
 {
   n_base_ele=0;
   n_base_muo=0;
@@ -60,12 +88,6 @@ SusyNtMaker::SusyNtMaker() : m_fillNt(true),
   n_evt_saved=0;
 }
 /*--------------------------------------------------------------------------------*/
-// Destructor
-/*--------------------------------------------------------------------------------*/
-SusyNtMaker::~SusyNtMaker()
-{
-}
-/*--------------------------------------------------------------------------------*/
 // The Begin() function is called at the start of the query.
 // When running with PROOF Begin() is only called on the client.
 // The tree argument is deprecated (on PROOF 0 is passed).
@@ -75,14 +97,22 @@ void SusyNtMaker::Begin(TTree* /*tree*/)
   SusyD3PDAna::Begin(0);
   if(m_dbg) cout << "SusyNtMaker::Begin" << endl;
 
+  // Per-sample state, the selector may have processed another sample before
+  resetCounters();
+  m_procCutFlows.clear();
+  m_lastEntry = -1;
+  m_progress.start();
+
   if(m_fillNt){
 
     // Open the output tree
-    m_outTreeFile = new TFile("susyNt.root", "recreate");
+    m_outTreeFile = new TFile(m_outFileName.c_str(), "recreate");
     m_outTree = new TTree("susyNt", "susyNt");
 
-    // Set autosave size (determines how often tree writes to disk)
-    m_outTree->SetAutoSave(10000000);
+    // Set autosave size (determines how often tree writes to disk). Checkpoints
+    // save the tree themselves, an autosave in between would save entries past
+    // the last entry of the checkpoint and a resume would process them again
+    m_outTree->SetAutoSave(m_checkpointEntries > 0? 0 : 10000000);
     // Max tree size determines when a new file and tree are written
     m_outTree->SetMaxTreeSize(3000000000u);
     // Set all branches active for writing, for now.
@@ -92,13 +122,14 @@ void SusyNtMaker::Begin(TTree* /*tree*/)
 
   }
 
-  // Susy sample determination is now done dynamically
+  // Susy sample determination is now done per file, see SusyD3PDAna::Notify
   //m_isSusySample = m_sample.Contains("DGemt") || m_sample.Contains("DGstau") ||
   //                 m_sample.Contains("RPV") || m_sample.Contains("simplifiedModel") ||
   //                 m_sample.Contains("pMSSM") || m_sample.Contains("DG_MeadePoint");
 
   // Still hardcoded. Currently no other known solution
   m_isHsignalSample = SusyNtMaker::isHiggsSignalSample(m_sample.Data());
+  m_isPowhegLfvHsignalSample = SusyNtMaker::isPowhegLfvHiggsSignalSample(m_sample.Data());
 
   // create histograms for cutflow
   // Raw event weights
@@ -108,6 +139,7 @@ void SusyNtMaker::Begin(TTree* /*tree*/)
 
   // Start the timer
   m_timer.Start();
+  m_startTime = time(0);
 }
 /*--------------------------------------------------------------------------------*/
 TH1F* SusyNtMaker::makeCutFlow(const char* name, const char* title)
@@ -132,6 +164,29 @@ TH1F* SusyNtMaker::makeCutFlow(const char* name, const char* title)
   return h;
 }
 /*--------------------------------------------------------------------------------*/
+TH1D* SusyNtMaker::makeCounterHist()
+{
+  const int nCounters = 24;
+  const char* labels[nCounters] = {
+    "BaseEle", "BaseMuo", "BaseTau", "BaseJet", "SigEle", "SigMuo", "SigTau", "SigJet",
+    "Initial", "SusyProp", "GRL", "LarErr", "TileErr", "TTC Veto", "GoodVtx", "WW Sherpa",
+    "TileTrip", "HotSpot", "BadJet", "BadMuon", "Cosmic", ">=1 Lep", ">=2 Lep", "==3 Lep"
+  };
+  const uint counts[nCounters] = {
+    n_base_ele, n_base_muo, n_base_tau, n_base_jet, n_sig_ele, n_sig_muo, n_sig_tau, n_sig_jet,
+    n_evt_initial, n_evt_susyProp, n_evt_grl, n_evt_larErr, n_evt_tileErr, n_evt_ttcVeto,
+    n_evt_goodVtx, n_evt_WwSherpa, n_evt_tileTrip, n_evt_hotSpot, n_evt_badJet, n_evt_badMu,
+    n_evt_cosmic, n_evt_1Lep, n_evt_2Lep, n_evt_3Lep
+  };
+
+  TH1D* h = new TH1D("counters", "counters;Counter;Entries", nCounters, 0., nCounters);
+  for(int i=0; i<nCounters; i++){
+    h->GetXaxis()->SetBinLabel(i+1, labels[i]);
+    h->SetBinContent(i+1, counts[i]);
+  }
+  return h;
+}
+/*--------------------------------------------------------------------------------*/
 TH1F* SusyNtMaker::getProcCutFlow(int signalProcess)
 {
   // Look for it on the map
@@ -141,8 +196,11 @@ TH1F* SusyNtMaker::getProcCutFlow(int signalProcess)
     stringstream stream;
     stream << signalProcess;
     string name = "procCutFlow" + stream.str();
-    return m_procCutFlows[signalProcess] = makeCutFlow(name.c_str(),
-                                                       (name+";Cuts;Events").c_str());
+    TH1F* h = makeCutFlow(name.c_str(), (name+";Cuts;Events").c_str());
+    // Made during the event loop, which may run in a looper thread whose
+    // gDirectory is not the output file
+    if(m_fillNt) h->SetDirectory(m_outTree->GetCurrentFile());
+    return m_procCutFlows[signalProcess] = h;
   }
   // Already saved process
   else{
@@ -158,11 +216,10 @@ Bool_t SusyNtMaker::Process(Long64_t entry)
   // Communicate the entry number to the interface objects
   GetEntry(entry);
 
-  static Long64_t chainEntry = -1;
-  chainEntry++;
-  if(m_dbg || chainEntry%5000==0)
+  m_progress.count();
+  if(m_dbg)
   {
-    cout << "**** Processing entry " << setw(6) << chainEntry
+    cout << "**** Processing entry " << setw(6) << m_progress.entries()
          << " run " << setw(6) << d3pd.evt.RunNumber()
          << " event " << setw(7) << d3pd.evt.EventNumber() << " ****" << endl;
   }
@@ -174,11 +231,64 @@ Bool_t SusyNtMaker::Process(Long64_t entry)
       abort();
     }
     n_evt_saved++;
+    m_progress.pass();
+  }
+  m_lastEntry = m_tree->GetReadEntry();
+
+  // Periodic checkpoint of the output
+  if(m_fillNt && m_checkpointEntries > 0 && m_progress.entries() % m_checkpointEntries == 0){
+    writeCheckpoint();
   }
 
+  // Stop cleanly before the deadline, Terminate still saves a resumable output
+  if(m_deadline > 0 && difftime(time(0), m_startTime) > m_deadline){
+    cout << "SusyNtMaker : deadline of " << m_deadline << " s reached after entry "
+         << m_lastEntry << ", stopping" << endl;
+    Abort("deadline reached");
+  }
+
+  endEntry();
   return kTRUE;
 }
 
+/*--------------------------------------------------------------------------------*/
+// Checkpoint: save the output tree, cutflows, counters and the last chain entry
+// processed so that the job can be resumed if it dies. The tree header written
+// here matches the histograms; autosave is off when checkpointing, so entries
+// filled afterwards are only saved by the next checkpoint or by Terminate.
+/*--------------------------------------------------------------------------------*/
+void SusyNtMaker::writeCheckpoint()
+{
+  if(m_dbg) cout << "SusyNtMaker::writeCheckpoint at entry " << m_lastEntry << endl;
+  TDirectory* dir = gDirectory;
+  m_outTreeFile = m_outTree->GetCurrentFile();
+  m_outTreeFile->cd();
+  TH1D* counters = makeCounterHist();
+  writeLastEntry();
+  m_outTreeFile->Write(0, TObject::kOverwrite);
+  m_outTreeFile->SaveSelf();
+  delete counters;
+  dir->cd();
+}
+/*--------------------------------------------------------------------------------*/
+void SusyNtMaker::writeLastEntry()
+{
+  // Merging several outputs keeps the maximum
+  TParameter<Long64_t> lastEntry("lastEntry", m_lastEntry, 'M');
+  lastEntry.Write(0, TObject::kOverwrite);
+}
+/*--------------------------------------------------------------------------------*/
+Long64_t SusyNtMaker::readLastEntry(std::string fileName)
+{
+  TFile* file = TFile::Open(fileName.c_str());
+  if(file == 0) return -1;
+  TParameter<Long64_t>* lastEntry = (TParameter<Long64_t>*) file->Get("lastEntry");
+  Long64_t entry = lastEntry? lastEntry->GetVal() : -1;
+  file->Close();
+  delete file;
+  return entry;
+}
+
 /*--------------------------------------------------------------------------------*/
 // The Terminate() function is the last function to be called during
 // a query. It always runs on the client, it can be used to present
@@ -227,6 +337,9 @@ void SusyNtMaker::Terminate()
 
     // Save the output tree
     m_outTreeFile = m_outTree->GetCurrentFile();
+    m_outTreeFile->cd();
+    makeCounterHist();
+    writeLastEntry();
     m_outTreeFile->Write(0, TObject::kOverwrite);
     cout << "susyNt tree saved to " << m_outTreeFile->GetName() << endl;
     m_outTreeFile->Close();
@@ -249,6 +362,7 @@ void SusyNtMaker::Terminate()
   printf(" Number of events saved:     %d \n",n_evt_saved);
   printf("\t Analysis time: Real %d:%02d:%02d, CPU %.3f      \n", hours, min, sec, cpuTime);
   printf("\t Analysis speed [kHz]: %2.3f                     \n",speed);
+  printIOStats();
   printf("---------------------------------------------------\n\n");
 }
 
@@ -259,24 +373,28 @@ bool SusyNtMaker::selectEvent()
 {
   if(m_dbg>=5) cout << "selectEvent" << endl;
 
-  m_susyObj.Reset();
+  // The event is processed in two phases. The cleaning cuts which filter the SusyNt
+  // in the first phase only read a few evt branches, so events rejected there never
+  // unzip the object or vertex baskets. The truth record is only read there for the
+  // SUSY propagator count of SUSY samples, whose cutflow bin comes before the GRL.
+  // Clearing the containers does not read.
   clearObjects();
   m_susyNt.clear();
 
-  // Dynamically determine if SUSY sample by looking for sparticle branches
-  bool isSusySample = d3pd.evt.SUSY_Spart1_pdgId.IsAvailable() &&
-                      d3pd.evt.SUSY_Spart2_pdgId.IsAvailable() &&
-                      d3pd.evt.SUSY_Spart1_pdgId() != 0        &&
+  // Reco truth matching is setup on the first query, see recoTruthMatch()
+  m_recoTruthMatchReady = false;
+  m_truthMatchQueries.clear();
+
+  //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-//
+  // Phase 1: event info
+
+  // Dynamically determine if SUSY sample, the sparticle branches are looked up in Notify
+  bool isSusySample = m_isSusySample                    &&
+                      d3pd.evt.SUSY_Spart1_pdgId() != 0 &&
                       d3pd.evt.SUSY_Spart2_pdgId() != 0;
 
   // Susy final state - NOTE: DEFAULT VALUE CHANGED FROM -1 TO 0
-  m_susyFinalState = isSusySample ? m_susyObj.finalState(d3pd.evt.SUSY_Spart1_pdgId(),
-                                                           d3pd.evt.SUSY_Spart2_pdgId()) : 0;
-  m_hDecay = smc::kUnknown;
-  if(m_isHsignalSample){ m_hDecay = WhTruthExtractor().update(d3pd.truth.pdgId(),
-                                                             d3pd.truth.child_index(),
-                                                             d3pd.truth.parent_index());
-  }
+  m_susyFinalState = isSusySample ? getSusyFinalState() : 0;
   // This assumes that sparticle branches are present for any
   // sample that might have the SUSY propagators problem
   m_hasSusyProp = (isSusySample ?
@@ -287,7 +405,7 @@ bool SusyNtMaker::selectEvent()
   // This way we can eventually drop the genCutFlow and just rely on procCutFlow
   //TH1F* h_procCutFlow = m_isSusySample ? getProcCutFlow(m_susyFinalState) : 0;
   TH1F* h_procCutFlow = getProcCutFlow(m_susyFinalState);
-  float w = m_isMC? d3pd.truth.event_weight() : 1;
+  float w = m_isMC? getGenWeight() : 1;
 
   // Cut index
   int cut = 0;
@@ -307,7 +425,7 @@ bool SusyNtMaker::selectEvent()
   //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-//
   // Obj Independent checks
 
-  checkEventCleaning();
+  checkEventInfoCleaning();
 
   // susyProp (just counts, doesn't drop)
   if(!m_hasSusyProp) { FillCutFlow(); n_evt_susyProp++; }
@@ -333,6 +451,19 @@ bool SusyNtMaker::selectEvent()
   FillCutFlow();
   n_evt_ttcVeto++;
 
+  //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-//
+  // Phase 2: the event passed the event info cuts, now read the collections
+
+  m_susyObj.Reset();
+
+  m_hDecay = smc::kUnknown;
+  if(m_isHsignalSample){ m_hDecay = WhTruthExtractor().update(d3pd.truth.pdgId(),
+                                                             d3pd.truth.child_index(),
+                                                             d3pd.truth.parent_index());
+  }
+
+  checkVertexCleaning();
+
   // primary vertex cut is actually filtered
   if(m_filter && (m_cutFlags & ECut_GoodVtx) == 0) return false;
   FillCutFlow();
@@ -390,17 +521,17 @@ bool SusyNtMaker::selectEvent()
           FillCutFlow();
           n_evt_cosmic++;
 
-          n_base_ele += m_baseElectrons.size();
-          n_base_muo += m_baseMuons.size();
-          n_base_tau += m_baseTaus.size();
-          n_base_jet += m_baseJets.size();
-          n_sig_ele += m_sigElectrons.size();
-          n_sig_muo += m_sigMuons.size();
-          n_sig_tau += m_sigTaus.size();
-          n_sig_jet += m_sigJets.size();
+          n_base_ele += baseElectrons().size();
+          n_base_muo += baseMuons().size();
+          n_base_tau += baseTaus().size();
+          n_base_jet += baseJets().size();
+          n_sig_ele += sigElectrons().size();
+          n_sig_muo += sigMuons().size();
+          n_sig_tau += sigTaus().size();
+          n_sig_jet += sigJets().size();
 
           // Lepton multiplicity
-          uint nSigLep = m_sigElectrons.size() + m_sigMuons.size();
+          uint nSigLep = sigElectrons().size() + sigMuons().size();
           //cout << "nSigLep " << nSigLep << endl;
           if(nSigLep >= 1){
             FillCutFlow();
@@ -425,21 +556,6 @@ bool SusyNtMaker::selectEvent()
   // I think so.
   matchTriggers();
 
-  // Setup reco truth matching
-  if(m_isMC){
-    m_recoTruthMatch = RecoTauMatch(0.1, d3pd.truth.channel_number(),
-                                    d3pd.truth.n(), d3pd.truth.barcode(), d3pd.truth.status(), d3pd.truth.pdgId(),
-                                    d3pd.truth.parents(), d3pd.truth.children(),
-                                    d3pd.truth.pt(), d3pd.truth.eta(), d3pd.truth.phi(), d3pd.truth.m(),
-                                    d3pd.jet.pt(), d3pd.jet.eta(), d3pd.jet.phi(), d3pd.jet.m(),
-                                    d3pd.jet.flavor_truth_label(),
-                                    d3pd.ele.pt(), d3pd.ele.eta(), d3pd.ele.phi(), d3pd.ele.m(),
-                                    d3pd.ele.type(), d3pd.ele.origin(),
-                                    d3pd.truthMu.pt(), d3pd.truthMu.eta(), d3pd.truthMu.phi(), d3pd.truthMu.m(),
-                                    d3pd.truthMu.type(), d3pd.truthMu.origin(),
-                                    d3pd.trk.pt(), d3pd.trk.eta(), d3pd.trk.phi_wrtPV(), d3pd.trk.mc_barcode());
-  }
-
   if(m_fillNt){
 
     // This will fill the pre selected
@@ -459,11 +575,72 @@ bool SusyNtMaker::selectEvent()
 
     // Trigger filtering, only save events for which one of our triggers has fired
     if(m_filterTrigger && (m_evtTrigFlags == 0)) return false;
+
+    // The event is saved, now do the truth matching of the saved objects
+    resolveTruthMatches();
   }
 
   return true;
 }
 
+/*--------------------------------------------------------------------------------*/
+// Reco truth matching. RecoTauMatch reads the truth, truthMu and the full track
+// collection, so it is only setup once a query is made for an object being saved.
+/*--------------------------------------------------------------------------------*/
+RecoTauMatch& SusyNtMaker::recoTruthMatch()
+{
+  if(!m_recoTruthMatchReady){
+    m_recoTruthMatch = RecoTauMatch(0.1, d3pd.truth.channel_number(),
+                                    d3pd.truth.n(), d3pd.truth.barcode(), d3pd.truth.status(), d3pd.truth.pdgId(),
+                                    d3pd.truth.parents(), d3pd.truth.children(),
+                                    d3pd.truth.pt(), d3pd.truth.eta(), d3pd.truth.phi(), d3pd.truth.m(),
+                                    d3pd.jet.pt(), d3pd.jet.eta(), d3pd.jet.phi(), d3pd.jet.m(),
+                                    d3pd.jet.flavor_truth_label(),
+                                    d3pd.ele.pt(), d3pd.ele.eta(), d3pd.ele.phi(), d3pd.ele.m(),
+                                    d3pd.ele.type(), d3pd.ele.origin(),
+                                    d3pd.truthMu.pt(), d3pd.truthMu.eta(), d3pd.truthMu.phi(), d3pd.truthMu.m(),
+                                    d3pd.truthMu.type(), d3pd.truthMu.origin(),
+                                    d3pd.trk.pt(), d3pd.trk.eta(), d3pd.trk.phi_wrtPV(), d3pd.trk.mc_barcode());
+    m_recoTruthMatchReady = true;
+  }
+  return m_recoTruthMatch;
+}
+/*--------------------------------------------------------------------------------*/
+void SusyNtMaker::queueTruthMatch(TruthMatchObj obj, uint ntIdx, const TLorentzVector& lv)
+{
+  TruthMatchQuery query;
+  query.obj   = obj;
+  query.ntIdx = ntIdx;
+  query.lv    = lv;
+  m_truthMatchQueries.push_back(query);
+}
+/*--------------------------------------------------------------------------------*/
+void SusyNtMaker::resolveTruthMatches()
+{
+  for(uint i=0; i<m_truthMatchQueries.size(); i++){
+    const TruthMatchQuery& query = m_truthMatchQueries[i];
+    const TLorentzVector& lv = query.lv;
+    if(query.obj == TruthMatch_Ele){
+      Susy::Electron* ele = & m_susyNt.ele()->at(query.ntIdx);
+      ele->isChargeFlip         = recoTruthMatch().isChargeFlip(lv, ele->q);
+      ele->matched2TruthLepton  = recoTruthMatch().Matched2TruthLepton(lv);
+      ele->truthType            = recoTruthMatch().fakeType(lv, ele->mcOrigin, ele->mcType);
+    }
+    else if(query.obj == TruthMatch_Muo){
+      Susy::Muon* muo = & m_susyNt.muo()->at(query.ntIdx);
+      muo->matched2TruthLepton  = recoTruthMatch().Matched2TruthLepton(lv);
+      muo->truthType            = recoTruthMatch().fakeType(lv, muo->mcOrigin, muo->mcType);
+    }
+    else{
+      Susy::Tau* tau = & m_susyNt.tau()->at(query.ntIdx);
+      tau->matched2TruthLepton  = recoTruthMatch().Matched2TruthLepton(lv, true);
+      tau->detailedTruthType    = recoTruthMatch().TauDetailedFakeType(lv);
+      tau->truthType            = recoTruthMatch().TauFakeType(tau->detailedTruthType);
+    }
+  }
+  m_truthMatchQueries.clear();
+}
+
 /*--------------------------------------------------------------------------------*/
 // Fill SusyNt variables
 /*--------------------------------------------------------------------------------*/
@@ -508,8 +685,8 @@ void SusyNtMaker::fillEventVars()
 
   // SUSY final state
   evt->susyFinalState   = m_susyFinalState;
-  evt->susySpartId1     = d3pd.evt.SUSY_Spart1_pdgId.IsAvailable()? d3pd.evt.SUSY_Spart1_pdgId() : 0;
-  evt->susySpartId2     = d3pd.evt.SUSY_Spart2_pdgId.IsAvailable()? d3pd.evt.SUSY_Spart2_pdgId() : 0;
+  evt->susySpartId1     = m_isSusySample? d3pd.evt.SUSY_Spart1_pdgId() : 0;
+  evt->susySpartId2     = m_isSusySample? d3pd.evt.SUSY_Spart2_pdgId() : 0;
 
   float mZ = -1.0, mZtruthMax = 40.0;
   if(m_isMC){
@@ -524,13 +701,17 @@ void SusyNtMaker::fillEventVars()
 
   evt->trigFlags        = m_evtTrigFlags;
 
-  evt->wPileup          = m_isMC? getPileupWeight() : 1;
-  evt->wPileup_up       = m_isMC? getPileupWeightUp() : 1;
-  evt->wPileup_dn       = m_isMC? getPileupWeightDown() : 1;
-  evt->wPileupAB3       = m_isMC? getPileupWeightAB3() : 1;
-  evt->wPileupAB        = m_isMC? getPileupWeightAB() : 1;
+  // All the pileup variants with one lookup
+  SusyPileupWeights::Weights wPileup;
+  for(int v=0; v<SusyPileupWeights::N_PU_VARIANTS; v++) wPileup.w[v] = 1;
+  if(m_isMC) wPileup = getPileupWeights();
+  evt->wPileup          = wPileup.w[SusyPileupWeights::PU_NOM];
+  evt->wPileup_up       = wPileup.w[SusyPileupWeights::PU_UP];
+  evt->wPileup_dn       = wPileup.w[SusyPileupWeights::PU_DN];
+  evt->wPileupAB3       = wPileup.w[SusyPileupWeights::PU_AB3];
+  evt->wPileupAB        = wPileup.w[SusyPileupWeights::PU_AB];
   //evt->wPileupIL        = m_isMC? getPileupWeightIL() : 1;
-  evt->wPileupAE        = m_isMC? getPileupWeightAE() : 1;
+  evt->wPileupAE        = wPileup.w[SusyPileupWeights::PU_AE];
   evt->xsec             = m_isMC? getXsecWeight() : 1;
   evt->errXsec          = m_isMC? m_errXsec : 1;
   evt->sumw             = m_isMC? m_sumw : 1;
@@ -566,12 +747,12 @@ void SusyNtMaker::fillElectronVars(const LeptonInfo* lepIn)
   Susy::Electron* eleOut = & m_susyNt.ele()->back();
   const ElectronElement* element = lepIn->getElectronElement();
 
-  // LorentzVector
-  const TLorentzVector* lv = lepIn->lv();
-  float pt  = lv->Pt() / GeV;
-  float eta = lv->Eta();
-  float phi = lv->Phi();
-  float m   = lv->M() / GeV;
+  // LorentzVector, from the kinematics table
+  uint idx  = lepIn->idx();
+  float pt  = m_kin.pt (SusyKinematics::ELE, idx) / GeV;
+  float eta = m_kin.eta(SusyKinematics::ELE, idx);
+  float phi = m_kin.phi(SusyKinematics::ELE, idx);
+  float m   = m_kin.m  (SusyKinematics::ELE, idx) / GeV;
 
   eleOut->SetPtEtaPhiM(pt, eta, phi, m);
   eleOut->pt            = pt;
@@ -592,10 +773,11 @@ void SusyNtMaker::fillElectronVars(const LeptonInfo* lepIn)
   eleOut->clusPhi       = element->cl_phi();
   eleOut->trackPt       = element->trackpt()/GeV;
 
-  // Check for charge flip
-  eleOut->isChargeFlip          = m_isMC? m_recoTruthMatch.isChargeFlip(*lv, element->charge()) : false;
-  eleOut->matched2TruthLepton   = m_isMC? m_recoTruthMatch.Matched2TruthLepton(*lv) : false;
-  eleOut->truthType             = m_isMC? m_recoTruthMatch.fakeType(*lv, element->origin(), element->type()) : -1;
+  // Charge flip and truth matching, done in resolveTruthMatches for saved events
+  eleOut->isChargeFlip          = false;
+  eleOut->matched2TruthLepton   = false;
+  eleOut->truthType             = -1;
+  if(m_isMC) queueTruthMatch(TruthMatch_Ele, m_susyNt.ele()->size()-1, *lepIn->lv());
 
   // IsEM quality flags - no need to recalculate them
   eleOut->mediumPP    = element->mediumPP();
@@ -631,7 +813,7 @@ void SusyNtMaker::fillElectronVars(const LeptonInfo* lepIn)
   eleOut->topoEtcone30Corr      = element->topoEtcone30_corrected()/GeV;
 
   // Trigger flags
-  eleOut->trigFlags     = m_eleTrigFlags[ lepIn->idx() ];
+  eleOut->trigFlags     = m_objs.trigFlags(SusyKinematics::ELE, lepIn->idx());
 
   // Efficiency scale factor.  For now, use tightPP if electrons is tightPP, otherwise mediumPP
   //int set               = eleOut->tightPP? 7 : 6;
@@ -640,7 +822,7 @@ void SusyNtMaker::fillElectronVars(const LeptonInfo* lepIn)
 
   // Tight electron SFs can come directly from SUSYTools
   // To get the SF uncert using GetSignalElecSF, we must get the shifted value and take the difference
-  float nomPt = lepIn->lv()->Pt();
+  float nomPt = m_kin.pt(SusyKinematics::ELE, idx);
   float sfPt = nomPt >= 7.*GeV ? nomPt : 7.*GeV;
   if(eleOut->tightPP){
     eleOut->effSF       = m_isMC?
@@ -653,8 +835,11 @@ void SusyNtMaker::fillElectronVars(const LeptonInfo* lepIn)
   // For the medium SF, need to use our own function
   else{
     float sf = 1, uncert = 0;
-    if (m_isMC) get_electron_eff_sf(sf, uncert, element->cl_eta(), sfPt, true, true, false, m_isAF2,
-                                    m_susyObj.GetElectron_recoSF_Class(), m_eleMediumSFTool, 0);
+    if (m_isMC){
+      R__LOCKGUARD(m_toolMutex);
+      get_electron_eff_sf(sf, uncert, element->cl_eta(), sfPt, true, true, false, m_isAF2,
+                          m_susyObj.GetElectron_recoSF_Class(), m_eleMediumSFTool, 0);
+    }
     eleOut->effSF       = sf;
     eleOut->errEffSF    = uncert;
   }
@@ -671,12 +856,12 @@ void SusyNtMaker::fillMuonVars(const LeptonInfo* lepIn)
   Susy::Muon* muOut = & m_susyNt.muo()->back();
   const MuonElement* element = lepIn->getMuonElement();
 
-  // LorentzVector
-  const TLorentzVector* lv = lepIn->lv();
-  float pt  = lv->Pt() / GeV;
-  float eta = lv->Eta();
-  float phi = lv->Phi();
-  float m   = lv->M() / GeV;
+  // LorentzVector, from the kinematics table
+  uint idx  = lepIn->idx();
+  float pt  = m_kin.pt (SusyKinematics::MUO, idx) / GeV;
+  float eta = m_kin.eta(SusyKinematics::MUO, idx);
+  float phi = m_kin.phi(SusyKinematics::MUO, idx);
+  float m   = m_kin.m  (SusyKinematics::MUO, idx) / GeV;
   muOut->SetPtEtaPhiM(pt, eta, phi, m);
   muOut->pt  = pt;
   muOut->eta = eta;
@@ -735,11 +920,11 @@ void SusyNtMaker::fillMuonVars(const LeptonInfo* lepIn)
       muOut->mcType     = trueMuon? trueMuon->type()   : 0;
       muOut->mcOrigin   = trueMuon? trueMuon->origin() : 0;
     }
-    muOut->matched2TruthLepton  = m_recoTruthMatch.Matched2TruthLepton(*lv);
-    muOut->truthType            = m_recoTruthMatch.fakeType(*lv, muOut->mcOrigin, muOut->mcType);
+    // Truth matching, done in resolveTruthMatches for saved events
+    queueTruthMatch(TruthMatch_Muo, m_susyNt.muo()->size()-1, *lepIn->lv());
   }
 
-  muOut->trigFlags      = m_muoTrigFlags[ lepIn->idx() ];
+  muOut->trigFlags      = m_objs.trigFlags(SusyKinematics::MUO, lepIn->idx());
 
   // Syntax of the GetSignalMuonSF has changed.  Now, the same method is used to get the nominal and shifted value.
   // So, in order to store the uncert, I take the shifted value minus the nominal, and save that.
@@ -759,8 +944,8 @@ void SusyNtMaker::fillJetVars()
   // Calculate random run/lb number, necessary for BCH cleaning flag
   if(m_isMC) calcRandomRunLB();
   // Loop over selected jets and fill output tree
-  for(uint iJet=0; iJet<m_preJets.size(); iJet++){
-    int jetIndex = m_preJets[iJet];
+  for(uint iJet=0; iJet<preJets().size(); iJet++){
+    int jetIndex = preJets()[iJet];
     fillJetVar(jetIndex);
   }
 }
@@ -771,11 +956,10 @@ void SusyNtMaker::fillJetVar(int jetIdx)
   m_susyNt.jet()->push_back( Susy::Jet() );
   Susy::Jet* jetOut = & m_susyNt.jet()->back();
 
-  const TLorentzVector* lv = & m_susyObj.GetJetTLV(jetIdx);
-  float pt  = lv->Pt() / GeV;
-  float eta = lv->Eta();
-  float phi = lv->Phi();
-  float m   = lv->M() / GeV;
+  float pt  = m_kin.pt (SusyKinematics::JET, jetIdx) / GeV;
+  float eta = m_kin.eta(SusyKinematics::JET, jetIdx);
+  float phi = m_kin.phi(SusyKinematics::JET, jetIdx);
+  float m   = m_kin.m  (SusyKinematics::JET, jetIdx) / GeV;
   jetOut->SetPtEtaPhiM(pt, eta, phi, m);
   jetOut->pt  = pt;
   jetOut->eta = eta;
@@ -844,8 +1028,8 @@ void SusyNtMaker::fillPhotonVars()
   if(m_dbg>=5) cout << "fillPhotonVars" << endl;
 
   // Loop over photons
-  for(uint iPh=0; iPh<m_sigPhotons.size(); iPh++){
-    int phIndex = m_sigPhotons[iPh];
+  for(uint iPh=0; iPh<sigPhotons().size(); iPh++){
+    int phIndex = sigPhotons()[iPh];
 
     fillPhotonVar(phIndex);
   }
@@ -860,11 +1044,10 @@ void SusyNtMaker::fillPhotonVar(int phIdx)
 
 
   // Set TLV
-  const TLorentzVector* phTLV = & m_susyObj.GetPhotonTLV(phIdx);
-  float pt  = phTLV->Pt() / GeV;
-  float E   = phTLV->E()  / GeV;
-  float eta = phTLV->Eta();
-  float phi = phTLV->Phi();
+  float pt  = m_kin.pt (SusyKinematics::PHO, phIdx) / GeV;
+  float E   = m_kin.e  (SusyKinematics::PHO, phIdx) / GeV;
+  float eta = m_kin.eta(SusyKinematics::PHO, phIdx);
+  float phi = m_kin.phi(SusyKinematics::PHO, phIdx);
 
   phoOut->SetPtEtaPhiE(pt, eta, phi, E);
   phoOut->pt  = pt;
@@ -887,7 +1070,7 @@ void SusyNtMaker::fillTauVars()
   if(m_dbg>=5) cout << "fillTauVars" << endl;
 
   // Loop over selected taus
-  vector<int>& saveTaus = m_saveContTaus? m_contTaus : m_preTaus;
+  const vector<int>& saveTaus = m_saveContTaus? contTaus() : preTaus();
   for(uint iTau=0; iTau < saveTaus.size(); iTau++){
     int tauIdx = saveTaus[iTau];
 
@@ -905,10 +1088,12 @@ void SusyNtMaker::fillTauVar(int tauIdx)
   // Set TLV
   //const TLorentzVector* tauLV = & m_tauLVs.at(tauIdx);
   const TLorentzVector* tauLV = & m_susyObj.GetTauTLV(tauIdx);
-  float pt  = tauLV->Pt() / GeV;
-  float eta = tauLV->Eta();
-  float phi = tauLV->Phi();
-  float m   = tauLV->M() / GeV;
+  double tauPt  = m_kin.pt (SusyKinematics::TAU, tauIdx);
+  double tauEta = m_kin.eta(SusyKinematics::TAU, tauIdx);
+  float pt  = tauPt / GeV;
+  float eta = tauEta;
+  float phi = m_kin.phi(SusyKinematics::TAU, tauIdx);
+  float m   = m_kin.m  (SusyKinematics::TAU, tauIdx) / GeV;
 
   tauOut->SetPtEtaPhiM(pt, eta, phi, m);
   tauOut->pt    = pt;
@@ -932,25 +1117,27 @@ void SusyNtMaker::fillTauVar(int tauIdx)
   //tauOut->eleBDTTight           = element->EleBDTTight();
   tauOut->eleBDTLoose           = m_susyObj.GetCorrectedEleBDTFlag(SUSYTau::TauLoose, element->EleBDTLoose(),
                                                                    element->BDTEleScore(), element->numTrack(),
-                                                                   tauLV->Pt(), element->leadTrack_eta());
+                                                                   tauPt, element->leadTrack_eta());
   tauOut->eleBDTMedium          = m_susyObj.GetCorrectedEleBDTFlag(SUSYTau::TauMedium, element->EleBDTMedium(),
                                                                    element->BDTEleScore(), element->numTrack(),
-                                                                   tauLV->Pt(), element->leadTrack_eta());
+                                                                   tauPt, element->leadTrack_eta());
   tauOut->eleBDTTight           = m_susyObj.GetCorrectedEleBDTFlag(SUSYTau::TauTight, element->EleBDTTight(),
                                                                    element->BDTEleScore(), element->numTrack(),
-                                                                   tauLV->Pt(), element->leadTrack_eta());
+                                                                   tauPt, element->leadTrack_eta());
 
   tauOut->muonVeto              = element->muonVeto();
 
   tauOut->trueTau               = m_isMC? element->trueTauAssocSmall_matched() : false;
 
-  tauOut->matched2TruthLepton   = m_isMC? m_recoTruthMatch.Matched2TruthLepton(*tauLV, true) : false;
-  tauOut->detailedTruthType     = m_isMC? m_recoTruthMatch.TauDetailedFakeType(*tauLV) : -1;
-  tauOut->truthType             = m_isMC? m_recoTruthMatch.TauFakeType(tauOut->detailedTruthType) : -1;
+  // Truth matching, done in resolveTruthMatches for saved events
+  tauOut->matched2TruthLepton   = false;
+  tauOut->detailedTruthType     = -1;
+  tauOut->truthType             = -1;
+  if(m_isMC) queueTruthMatch(TruthMatch_Tau, m_susyNt.tau()->size()-1, *tauLV);
 
   // ID efficiency scale factors
   if(m_isMC){
-    #define TAU_ARGS TauCorrUncert::BDTLOOSE, tauLV->Eta(), element->numTrack()
+    #define TAU_ARGS TauCorrUncert::BDTLOOSE, tauEta, element->numTrack()
     //TauCorrections* tauSF       = m_susyObj.GetTauCorrectionsProvider();
     TauCorrUncert::TauSF* tauSF = m_susyObj.GetSFTool();
     //tauOut->looseEffSF        = tauSF->GetIDSF(TauCorrUncert::BDTLOOSE, tauLV->Eta(), element->numTrack());
@@ -979,7 +1166,7 @@ void SusyNtMaker::fillTauVar(int tauIdx)
     }
   }
 
-  tauOut->trigFlags             = m_tauTrigFlags[tauIdx];
+  tauOut->trigFlags             = m_objs.trigFlags(SusyKinematics::TAU, tauIdx);
 
   tauOut->idx   = tauIdx;
 }
@@ -1087,8 +1274,8 @@ void SusyNtMaker::fillTruthParticleVars()
   if(m_dbg>=5) cout << "fillTruthParticleVars" << endl;
 
   // Retrieve indicies
-  m_truParticles        = m_recoTruthMatch.LepFromHS_McIdx();
-  vector<int> truthTaus = m_recoTruthMatch.TauFromHS_McIdx();
+  m_truParticles        = recoTruthMatch().LepFromHS_McIdx();
+  vector<int> truthTaus = recoTruthMatch().TauFromHS_McIdx();
   m_truParticles.insert( m_truParticles.end(), truthTaus.begin(), truthTaus.end() );
   if(m_isMC){
       if(isMcAtNloTtbar(d3pd.truth.channel_number())){
@@ -1102,7 +1289,7 @@ void SusyNtMaker::fillTruthParticleVars()
                                                              d3pd.truth.child_index(),
                                                              d3pd.truth.parent_index());
           m_truParticles.insert(m_truParticles.end(), indices.begin(), indices.end());
-          if(SusyNtMaker::isPowhegLfvHiggsSignalSample(m_sample.Data()))
+          if(m_isPowhegLfvHsignalSample)
               computeHiggsPtUncertaintyParameters(indices,
                                                   m_susyNt.evt()->higgs_pt, m_susyNt.evt()->n_truth_jets);
       }
@@ -1194,12 +1381,9 @@ void SusyNtMaker::doSystematic()
     SusyNtSys sys = (SusyNtSys) i;
     if(m_dbg>=5) cout << "Doing sys " << SusyNtSystNames[sys] << endl;
 
-    // Reset Objects
-    m_susyObj.Reset();
-    clearObjects();
-
-    selectObjects(sys);
-    buildMet(sys);
+    // Recalibrate the collections this sys affects, restore the ones the
+    // previous sys affected, and redo the selection steps depending on them
+    reselectObjects(sys);
 
     checkEventCleaning();
     checkObjectCleaning();
@@ -1233,7 +1417,7 @@ void SusyNtMaker::saveElectronSF(SusyNtSys sys)
     if(!lep->isElectron()) continue;
 
     // Systematic shifted energy
-    float E_sys = lep->lv()->E() / GeV;
+    float E_sys = m_kin.e(SusyKinematics::ELE, lep->idx()) / GeV;
 
     // Try to find this electron in the list of SusyNt electrons
     Susy::Electron* eleOut = 0;
@@ -1305,7 +1489,7 @@ void SusyNtMaker::saveMuonSF(SusyNtSys sys)
     if(lep->isElectron()) continue;
 
     // Systematic shifted energy
-    float E_sys = lep->lv()->E() / GeV;
+    float E_sys = m_kin.e(SusyKinematics::MUO, lep->idx()) / GeV;
 
     // Try to find this muon in the list of SusyNt muons
     Susy::Muon* muOut = 0;
@@ -1356,11 +1540,11 @@ void SusyNtMaker::saveMuonSF(SusyNtSys sys)
 void SusyNtMaker::saveJetSF(SusyNtSys sys)
 {
   // Loop over selected jets and fill the systematic shifts
-  for(uint iJet=0; iJet<m_preJets.size(); iJet++){
-    uint jetIdx = m_preJets[iJet];
+  for(uint iJet=0; iJet<preJets().size(); iJet++){
+    uint jetIdx = preJets()[iJet];
 
     // Systematic shifted energy
-    float E_sys = m_susyObj.GetJetTLV(jetIdx).E() / GeV;
+    float E_sys = m_kin.e(SusyKinematics::JET, jetIdx) / GeV;
 
     // Try to find this jet in the list of SusyNt jets
     Susy::Jet* jetOut = 0;
@@ -1410,11 +1594,11 @@ void SusyNtMaker::saveJetSF(SusyNtSys sys)
 void SusyNtMaker::saveTauSF(SusyNtSys sys)
 {
   // Loop over preselected taus and fill systematic shifts
-  for(uint iTau=0; iTau<m_preTaus.size(); iTau++){
-    uint tauIdx = m_preTaus[iTau];
+  for(uint iTau=0; iTau<preTaus().size(); iTau++){
+    uint tauIdx = preTaus()[iTau];
 
     // Get the systematic shifted E, used to calculate a shift factor
-    float E_sys = m_susyObj.GetTauTLV(tauIdx).E() / GeV;
+    float E_sys = m_kin.e(SusyKinematics::TAU, tauIdx) / GeV;
 
     // Try to find this tau in the list of SusyNt taus
     Susy::Tau* tauOut = 0;
@@ -1454,6 +1638,7 @@ void SusyNtMaker::addMissingElectron(const LeptonInfo* lep, SusyNtSys sys)
   const ElectronElement* element = lep->getElectronElement();
   m_susyObj.SetElecTLV(lep->idx(), element->eta(), element->phi(), element->cl_eta(), element->cl_phi(), element->cl_E(),
                        element->tracketa(), element->trackphi(), element->nPixHits(), element->nSCTHits(), SystErr::NONE);
+  fillKinematics(SusyKinematics::ELE, lep->idx());
 
   // Now push it back onto to susyNt
   fillElectronVars(lep);
@@ -1508,6 +1693,7 @@ void SusyNtMaker::addMissingMuon(const LeptonInfo* lep, SusyNtSys sys)
                        element->isSegmentTaggedMuon(), SystErr::NONE);
   //m_susyObj.SetMuonTLV(index, pt, eta, phi, me_qoverp_exPV, id_qoverp_exPV, me_theta_exPV,
                        //id_theta_exPV, charge, isCombined, isSegTag, SystErr::NONE);
+  fillKinematics(SusyKinematics::MUO, lep->idx());
 
   // Now push it back onto to susyNt
   fillMuonVars(lep);
@@ -1542,6 +1728,7 @@ void SusyNtMaker::addMissingJet(int index, SusyNtSys sys)
                     d3pd.evt.Eventshape_rhoKt4LC(),
                     d3pd.evt.averageIntPerXing(),
                     d3pd.vtx.nTracks());
+  fillKinematics(SusyKinematics::JET, index);
 
   // Need to save the calibrated TLV
   //TLorentzVector tlv_nom;
@@ -1603,6 +1790,7 @@ void SusyNtMaker::addMissingTau(int index, SusyNtSys sys)
   // regardless of our current systematic.
   m_susyObj.SetTauTLV(index, element->pt(), element->eta(), element->phi(), element->Et(), element->numTrack(),
                       element->leadTrack_eta(), SUSYTau::TauMedium, SystErr::NONE, true);
+  fillKinematics(SusyKinematics::TAU, index);
 
   // Fill the tau vars for this guy
   fillTauVar(index);
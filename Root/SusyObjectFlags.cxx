@@ -0,0 +1,110 @@
+#include "SusyCommon/SusyObjectFlags.h"
+
+using namespace std;
+
+/*--------------------------------------------------------------------------------*/
+// SusyObjectFlags Constructor
+/*--------------------------------------------------------------------------------*/
+SusyObjectFlags::SusyObjectFlags()
+{
+  for(int c=0; c<SusyKinematics::N_COLLECTIONS; c++){
+    for(int f=0; f<N_OBJ_FLAGS; f++) m_states[c].valid[f] = true;
+  }
+}
+/*--------------------------------------------------------------------------------*/
+int SusyObjectFlags::flagBit(ObjectFlag flag)
+{
+  int bit = 0;
+  while((1u << bit) != (uint) flag) bit++;
+  return bit;
+}
+
+/*--------------------------------------------------------------------------------*/
+// Sizes and resets
+/*--------------------------------------------------------------------------------*/
+void SusyObjectFlags::resize(Collection c, uint n)
+{
+  State& s = m_states[c];
+  // Objects beyond the new size may be in the views
+  if(n < s.words.size()){
+    for(int f=0; f<N_OBJ_FLAGS; f++) s.valid[f] = false;
+  }
+  s.words.resize(n, 0);
+  s.trig.resize(n, 0);
+}
+/*--------------------------------------------------------------------------------*/
+void SusyObjectFlags::clear(uint flags)
+{
+  for(int c=0; c<SusyKinematics::N_COLLECTIONS; c++){
+    State& s = m_states[c];
+    for(uint i=0; i<s.words.size(); i++) s.words[i] &= ~flags;
+    if(flags & OBJ_TRIG) s.trig.assign(s.trig.size(), 0);
+    // No object has the cleared flags anymore
+    for(int f=0; f<N_OBJ_FLAGS; f++){
+      if(!(flags & (1u << f))) continue;
+      s.views[f].clear();
+      s.valid[f] = true;
+    }
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+// Flag updates
+/*--------------------------------------------------------------------------------*/
+void SusyObjectFlags::setObjects(Collection c, ObjectFlag flag, const vector<int>& idx)
+{
+  State& s = m_states[c];
+  for(uint i=0; i<s.words.size(); i++) s.words[i] &= ~flag;
+  for(uint i=0; i<idx.size(); i++){
+    uint iObj = idx[i];
+    if(iObj >= s.words.size()) resize(c, iObj + 1);
+    s.words[iObj] |= flag;
+  }
+  int f = flagBit(flag);
+  s.views[f].assign(idx.begin(), idx.end());
+  s.valid[f] = true;
+}
+/*--------------------------------------------------------------------------------*/
+void SusyObjectFlags::setFlag(Collection c, uint i, ObjectFlag flag)
+{
+  State& s = m_states[c];
+  if(i >= s.words.size()) resize(c, i + 1);
+  if(s.words[i] & flag) return;
+  s.words[i] |= flag;
+  s.valid[flagBit(flag)] = false;
+}
+/*--------------------------------------------------------------------------------*/
+void SusyObjectFlags::resetFlag(Collection c, uint i, ObjectFlag flag)
+{
+  State& s = m_states[c];
+  if(i >= s.words.size() || !(s.words[i] & flag)) return;
+  s.words[i] &= ~flag;
+  s.valid[flagBit(flag)] = false;
+}
+/*--------------------------------------------------------------------------------*/
+void SusyObjectFlags::setTrigFlags(Collection c, uint i, long long trigFlags)
+{
+  State& s = m_states[c];
+  if(i >= s.words.size()) resize(c, i + 1);
+  s.trig[i] = trigFlags;
+  if(trigFlags != 0) setFlag(c, i, OBJ_TRIG);
+  else resetFlag(c, i, OBJ_TRIG);
+}
+
+/*--------------------------------------------------------------------------------*/
+// Index views, rebuilt from the flags when needed
+/*--------------------------------------------------------------------------------*/
+const vector<int>& SusyObjectFlags::objects(Collection c, ObjectFlag flag)
+{
+  State& s = m_states[c];
+  int f = flagBit(flag);
+  vector<int>& view = s.views[f];
+  if(!s.valid[f]){
+    view.clear();
+    for(uint i=0; i<s.words.size(); i++){
+      if(s.words[i] & flag) view.push_back(i);
+    }
+    s.valid[f] = true;
+  }
+  return view;
+}
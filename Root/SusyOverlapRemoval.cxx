@@ -0,0 +1,266 @@
+#include <cmath>
+
+#include "TMath.h"
+
+#include "SusyCommon/SusyOverlapRemoval.h"
+
+// The AVX2 kernel needs the target attribute, so that this file is built
+// without -mavx2 and the kernel is only called on CPUs which support it
+#if defined(__x86_64__) && (defined(__clang__) || \
+    (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define SUSYOR_AVX2
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// Same constants as TVector2::Phi_mpi_pi
+static const double OR_PI    = TMath::Pi();
+static const double OR_TWOPI = 2.*OR_PI;
+
+/*--------------------------------------------------------------------------------*/
+// Kernels: one row of the DeltaR^2 matrix, dR2[j] for the object at (eta, phi)
+// and the objects j of the second list. Both do the arithmetic of
+// TLorentzVector::DeltaR, the phi differences are within [-2pi, 2pi] so
+// Phi_mpi_pi needs at most one shift.
+/*--------------------------------------------------------------------------------*/
+static void dR2RowScalar(double eta, double phi, const double* eta2, const double* phi2,
+                         uint n, double* dR2)
+{
+  for(uint j=0; j<n; j++){
+    double dEta = eta - eta2[j];
+    double dPhi = phi - phi2[j];
+    if(dPhi >= OR_PI) dPhi -= OR_TWOPI;
+    else if(dPhi < -OR_PI) dPhi += OR_TWOPI;
+    dR2[j] = dEta*dEta + dPhi*dPhi;
+  }
+}
+#ifdef SUSYOR_AVX2
+__attribute__((target("avx2")))
+static void dR2RowAvx2(double eta, double phi, const double* eta2, const double* phi2,
+                       uint n, double* dR2)
+{
+  const __m256d vEta   = _mm256_set1_pd(eta);
+  const __m256d vPhi   = _mm256_set1_pd(phi);
+  const __m256d pi     = _mm256_set1_pd(OR_PI);
+  const __m256d minusPi= _mm256_set1_pd(-OR_PI);
+  const __m256d twoPi  = _mm256_set1_pd(OR_TWOPI);
+  uint j = 0;
+  for(; j+4<=n; j+=4){
+    __m256d dEta = _mm256_sub_pd(vEta, _mm256_loadu_pd(eta2 + j));
+    __m256d dPhi = _mm256_sub_pd(vPhi, _mm256_loadu_pd(phi2 + j));
+    // Shift down where dPhi >= pi, up where dPhi < -pi; NaN lanes are left alone
+    __m256d above = _mm256_cmp_pd(dPhi, pi, _CMP_GE_OQ);
+    __m256d below = _mm256_cmp_pd(dPhi, minusPi, _CMP_LT_OQ);
+    __m256d down  = _mm256_sub_pd(dPhi, twoPi);
+    __m256d up    = _mm256_add_pd(dPhi, twoPi);
+    dPhi = _mm256_blendv_pd(dPhi, down, above);
+    dPhi = _mm256_blendv_pd(dPhi, up, below);
+    __m256d d = _mm256_add_pd(_mm256_mul_pd(dEta, dEta), _mm256_mul_pd(dPhi, dPhi));
+    _mm256_storeu_pd(dR2 + j, d);
+  }
+  dR2RowScalar(eta, phi, eta2 + j, phi2 + j, n - j, dR2 + j);
+}
+#endif
+
+/*--------------------------------------------------------------------------------*/
+// SusyOverlapRemoval Constructor
+/*--------------------------------------------------------------------------------*/
+SusyOverlapRemoval::SusyOverlapRemoval() :
+        m_useAvx2(hasAvx2())
+{
+}
+/*--------------------------------------------------------------------------------*/
+bool SusyOverlapRemoval::hasAvx2()
+{
+  #ifdef SUSYOR_AVX2
+  static const bool avx2 = __builtin_cpu_supports("avx2");
+  return avx2;
+  #else
+  return false;
+  #endif
+}
+/*--------------------------------------------------------------------------------*/
+double SusyOverlapRemoval::dR2Threshold(float cut)
+{
+  // The square root is correctly rounded and monotonic, so sqrt(x) < cut
+  // exactly when x is below the smallest x with sqrt(x) >= cut
+  double dRCut = cut;
+  double threshold = dRCut * dRCut;
+  while(threshold > 0 && sqrt(threshold) >= dRCut) threshold = nextafter(threshold, 0.);
+  while(sqrt(threshold) < dRCut) threshold = nextafter(threshold, HUGE_VAL);
+  return threshold;
+}
+
+/*--------------------------------------------------------------------------------*/
+// Overlap removal, in the order of the chained overlap_removal calls
+/*--------------------------------------------------------------------------------*/
+void SusyOverlapRemoval::apply(const SusyKinematics& kin, bool doTaus, SusyObjectFlags& objs)
+{
+  static const double dR2EE = dR2Threshold(0.05);
+  static const double dR2JE = dR2Threshold(0.2);
+  static const double dR2TL = dR2Threshold(0.2);
+  static const double dR2EJ = dR2Threshold(0.4);
+  static const double dR2MJ = dR2Threshold(0.4);
+  static const double dR2EM = dR2Threshold(0.01);
+  static const double dR2MM = dR2Threshold(0.05);
+  static const double dR2JT = dR2Threshold(0.2);
+
+  const vector<int>& preElectrons = objs.objects(SusyKinematics::ELE, SusyObjectFlags::OBJ_PRE);
+  const vector<int>& preMuons     = objs.objects(SusyKinematics::MUO, SusyObjectFlags::OBJ_PRE);
+  const vector<int>& preJets      = objs.objects(SusyKinematics::JET, SusyObjectFlags::OBJ_PRE);
+  const vector<int>& preTaus      = objs.objects(SusyKinematics::TAU, SusyObjectFlags::OBJ_PRE);
+
+  gather(kin, SusyKinematics::ELE, preElectrons, m_ele);
+  gather(kin, SusyKinematics::MUO, preMuons, m_muo);
+  gather(kin, SusyKinematics::JET, preJets, m_jet);
+  m_elePt.resize(preElectrons.size());
+  for(uint i=0; i<preElectrons.size(); i++) m_elePt[i] = kin.pt(SusyKinematics::ELE, preElectrons[i]);
+
+  // One matrix per collection pair, the steps only read them
+  fillMatrix(m_ele, m_ele, m_dR2EE);
+  fillMatrix(m_jet, m_ele, m_dR2JE);
+  fillMatrix(m_muo, m_jet, m_dR2MJ);
+  fillMatrix(m_ele, m_muo, m_dR2EM);
+  fillMatrix(m_muo, m_muo, m_dR2MM);
+  if(doTaus){
+    gather(kin, SusyKinematics::TAU, preTaus, m_tau);
+    fillMatrix(m_tau, m_ele, m_dR2TE);
+    fillMatrix(m_tau, m_muo, m_dR2TM);
+    fillMatrix(m_jet, m_tau, m_dR2JT);
+  }
+
+  m_eleAlive.assign(preElectrons.size(), 1);
+  m_muoAlive.assign(preMuons.size(), 1);
+  m_jetAlive.assign(preJets.size(), 1);
+  m_tauAlive.assign(doTaus? preTaus.size() : 0, 1);
+
+  // e-e, against all the preselected electrons
+  m_tmpAlive.assign(preElectrons.size(), 1);
+  removeOverlaps(m_dR2EE, true, dR2EE, m_eleAlive, m_tmpAlive, true, &m_elePt);
+  // jet-e
+  removeOverlaps(m_dR2JE, true, dR2JE, m_jetAlive, m_eleAlive);
+  if(doTaus){
+    // tau-e, tau-mu against all the preselected muons
+    removeOverlaps(m_dR2TE, true, dR2TL, m_tauAlive, m_eleAlive);
+    m_tmpAlive.assign(preMuons.size(), 1);
+    removeOverlaps(m_dR2TM, true, dR2TL, m_tauAlive, m_tmpAlive);
+  }
+  // e-jet
+  removeOverlaps(m_dR2JE, false, dR2EJ, m_eleAlive, m_jetAlive);
+  // mu-jet
+  removeOverlaps(m_dR2MJ, true, dR2MJ, m_muoAlive, m_jetAlive);
+  // e-mu, the muons are checked against the electrons before the e-mu removal
+  m_tmpAlive = m_eleAlive;
+  removeOverlaps(m_dR2EM, true, dR2EM, m_eleAlive, m_muoAlive);
+  removeOverlaps(m_dR2EM, false, dR2EM, m_muoAlive, m_tmpAlive);
+  // mu-mu, both muons of a pair are removed
+  m_tmpAlive = m_muoAlive;
+  removeOverlaps(m_dR2MM, true, dR2MM, m_muoAlive, m_tmpAlive, true);
+  // jet-tau
+  if(doTaus) removeOverlaps(m_dR2JT, true, dR2JT, m_jetAlive, m_tauAlive);
+
+  // SFOS pairs with Mll < 12 GeV
+  removeSFOSPairs(kin, SusyKinematics::ELE, preElectrons, m_eleAlive, 12000.);
+  removeSFOSPairs(kin, SusyKinematics::MUO, preMuons, m_muoAlive, 12000.);
+
+  select(objs, SusyKinematics::ELE, preElectrons, m_eleAlive);
+  select(objs, SusyKinematics::MUO, preMuons, m_muoAlive);
+  select(objs, SusyKinematics::JET, preJets, m_jetAlive);
+  if(doTaus) select(objs, SusyKinematics::TAU, preTaus, m_tauAlive);
+}
+
+/*--------------------------------------------------------------------------------*/
+// Matrices
+/*--------------------------------------------------------------------------------*/
+void SusyOverlapRemoval::gather(const SusyKinematics& kin, SusyKinematics::Collection c,
+                                const vector<int>& idx, Coords& coords)
+{
+  uint n = idx.size();
+  coords.eta.resize(n);
+  coords.phi.resize(n);
+  for(uint i=0; i<n; i++){
+    coords.eta[i] = kin.eta(c, idx[i]);
+    coords.phi[i] = kin.phi(c, idx[i]);
+  }
+}
+/*--------------------------------------------------------------------------------*/
+void SusyOverlapRemoval::fillMatrix(const Coords& c1, const Coords& c2, vector<double>& dR2)
+{
+  uint n1 = c1.eta.size();
+  uint n2 = c2.eta.size();
+  dR2.resize(n1 * n2);
+  if(n1 == 0 || n2 == 0) return;
+  for(uint i=0; i<n1; i++){
+    #ifdef SUSYOR_AVX2
+    if(m_useAvx2){
+      dR2RowAvx2(c1.eta[i], c1.phi[i], &c2.eta[0], &c2.phi[0], n2, &dR2[i*n2]);
+      continue;
+    }
+    #endif
+    dR2RowScalar(c1.eta[i], c1.phi[i], &c2.eta[0], &c2.phi[0], n2, &dR2[i*n2]);
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+// Mask updates
+/*--------------------------------------------------------------------------------*/
+void SusyOverlapRemoval::removeOverlaps(const vector<double>& dR2, bool rows, double threshold,
+                                        vector<char>& alive1, const vector<char>& mask2,
+                                        bool sameType, const vector<double>* pt)
+{
+  uint n1 = alive1.size();
+  uint n2 = mask2.size();
+  for(uint i=0; i<n1; i++){
+    if(!alive1[i]) continue;
+    for(uint j=0; j<n2; j++){
+      if(!mask2[j]) continue;
+      if(sameType && i == j) continue;
+      if(pt && (*pt)[i] > (*pt)[j]) continue;
+      double d = rows? dR2[i*n2 + j] : dR2[j*n1 + i];
+      if(d < threshold){
+        alive1[i] = 0;
+        break;
+      }
+    }
+  }
+}
+/*--------------------------------------------------------------------------------*/
+void SusyOverlapRemoval::removeSFOSPairs(const SusyKinematics& kin, SusyKinematics::Collection c,
+                                         const vector<int>& idx, vector<char>& alive, float mllCut)
+{
+  const SusyKinematics::Table& t = kin.table(c);
+  uint n = idx.size();
+  // All the pairs are checked before removing any lepton
+  m_tmpAlive = alive;
+  for(uint i=0; i<n; i++){
+    if(!m_tmpAlive[i]) continue;
+    int i1 = idx[i];
+    for(uint j=i+1; j<n; j++){
+      if(!m_tmpAlive[j]) continue;
+      int i2 = idx[j];
+      if(t.q[i1] * t.q[i2] >= 0) continue;
+      // Same as (lv1 + lv2).M()
+      double px = t.px[i1] + t.px[i2];
+      double py = t.py[i1] + t.py[i2];
+      double pz = t.pz[i1] + t.pz[i2];
+      double e  = t.e[i1] + t.e[i2];
+      double mm = e*e - (px*px + py*py + pz*pz);
+      double mll = mm < 0? -TMath::Sqrt(-mm) : TMath::Sqrt(mm);
+      if(mll < mllCut){
+        alive[i] = 0;
+        alive[j] = 0;
+      }
+    }
+  }
+}
+/*--------------------------------------------------------------------------------*/
+void SusyOverlapRemoval::select(SusyObjectFlags& objs, SusyKinematics::Collection c,
+                                const vector<int>& idx, const vector<char>& alive)
+{
+  m_selected.clear();
+  for(uint i=0; i<idx.size(); i++){
+    if(alive[i]) m_selected.push_back(idx[i]);
+  }
+  objs.setObjects(c, SusyObjectFlags::OBJ_BASE, m_selected);
+}
@@ -0,0 +1,122 @@
+#include <iostream>
+
+#include "SusyCommon/SusyPileupWeights.h"
+
+using namespace std;
+
+// MC pileup profiles, common to all the variants
+static const char* PRW_CONFIG_FILE = "$ROOTCOREBIN/data/PileupReweighting/mc12ab_defaults.prw.root";
+
+// Settings of each variant, in Variant order
+struct PileupVariantConfig
+{
+  const char*   name;           // tool name
+  double        dataScale;      // data mu scale factor
+  const char*   lumiCalcFile;   // data lumi and mu profile
+};
+static const PileupVariantConfig PILEUP_VARIANTS[SusyPileupWeights::N_PU_VARIANTS] = {
+  { "PileupReweighting",    1/1.11, "$ROOTCOREBIN/data/MultiLep/ilumicalc_histograms_EF_2e12Tvh_loose1_200842-215643_grl_v61.root" },
+  { "PileupReweighting",    1/1.08, "$ROOTCOREBIN/data/MultiLep/ilumicalc_histograms_EF_2e12Tvh_loose1_200842-215643_grl_v61.root" },
+  { "PileupReweighting",    1/1.14, "$ROOTCOREBIN/data/MultiLep/ilumicalc_histograms_EF_2e12Tvh_loose1_200842-215643_grl_v61.root" },
+  { "PileupReweightingAB3", 1/1.11, "$ROOTCOREBIN/data/MultiLep/ilumicalc_histograms_EF_2e12Tvh_loose1_200841-203195.root" },
+  { "PileupReweightingAB",  1/1.11, "$ROOTCOREBIN/data/MultiLep/ilumicalc_histograms_EF_e24vhi_medium1_200841-205113.root" },
+  { "PileupReweightingAE",  1/1.11, "$ROOTCOREBIN/data/MultiLep/ilumicalc_histograms_EF_2e12Tvh_loose1_200841-210308.root" }
+};
+
+// The memo is cleared when it grows past this size, e.g. for continuous mu values
+static const size_t MAX_MEMO_SIZE = 100000;
+
+/*--------------------------------------------------------------------------------*/
+// SusyPileupWeights Constructor
+/*--------------------------------------------------------------------------------*/
+SusyPileupWeights::SusyPileupWeights() :
+        m_nHits(0),
+        m_nMisses(0)
+{
+  for(int v=0; v<N_PU_VARIANTS; v++) m_tools[v] = 0;
+}
+/*--------------------------------------------------------------------------------*/
+// Destructor
+/*--------------------------------------------------------------------------------*/
+SusyPileupWeights::~SusyPileupWeights()
+{
+  for(int v=0; v<N_PU_VARIANTS; v++) delete m_tools[v];
+}
+
+/*--------------------------------------------------------------------------------*/
+// Build the tools
+/*--------------------------------------------------------------------------------*/
+int SusyPileupWeights::initialize()
+{
+  for(int v=0; v<N_PU_VARIANTS; v++){
+    const PileupVariantConfig& config = PILEUP_VARIANTS[v];
+    Root::TPileupReweighting* tool = new Root::TPileupReweighting(config.name);
+    tool->SetDataScaleFactors(config.dataScale);
+    tool->AddConfigFile(PRW_CONFIG_FILE);
+    tool->AddLumiCalcFile(config.lumiCalcFile);
+    tool->SetUnrepresentedDataAction(2);
+    m_tools[v] = tool;
+    int pileupError = tool->Initialize();
+    if(pileupError){
+      cout << "Problem in pileup initialization.  pileupError = " << pileupError << endl;
+      return pileupError;
+    }
+  }
+  m_memo.clear();
+  return 0;
+}
+
+/*--------------------------------------------------------------------------------*/
+// Weights of all the variants
+/*--------------------------------------------------------------------------------*/
+const SusyPileupWeights::Weights& SusyPileupWeights::getWeights(uint run, uint channel, float mu)
+{
+  Key key;
+  key.run     = run;
+  key.channel = channel;
+  key.mu      = mu;
+
+  map<Key, Weights>::iterator it = m_memo.find(key);
+  if(it != m_memo.end()){
+    m_nHits++;
+    return it->second;
+  }
+
+  m_nMisses++;
+  if(m_memo.size() >= MAX_MEMO_SIZE) m_memo.clear();
+  Weights& weights = m_memo[key];
+  for(int v=0; v<N_PU_VARIANTS; v++){
+    weights.w[v] = m_tools[v]->GetCombinedWeight(run, channel, mu);
+  }
+  return weights;
+}
+
+/*--------------------------------------------------------------------------------*/
+// Random run and lumi block numbers
+/*--------------------------------------------------------------------------------*/
+void SusyPileupWeights::setRandomSeed(uint run, uint event)
+{
+  // TRandom3 takes a seed of 0 as "seed from the clock"
+  uint seed = (event * 2654435761u) ^ (run * 40503u);
+  m_tools[PU_NOM]->SetRandomSeed(seed? seed : 1);
+}
+/*--------------------------------------------------------------------------------*/
+uint SusyPileupWeights::getRandomRunNumber(uint run)
+{
+  return m_tools[PU_NOM]->GetRandomRunNumber(run);
+}
+/*--------------------------------------------------------------------------------*/
+uint SusyPileupWeights::getRandomLumiBlockNumber(uint run)
+{
+  return m_tools[PU_NOM]->GetRandomLumiBlockNumber(run);
+}
+
+/*--------------------------------------------------------------------------------*/
+// Memo statistics
+/*--------------------------------------------------------------------------------*/
+void SusyPileupWeights::printStats()
+{
+  Long64_t nLookups = m_nHits + m_nMisses;
+  cout << "Pileup weights: " << nLookups << " lookups, " << m_nMisses << " computed, "
+       << m_memo.size() << " keys in memo" << endl;
+}
@@ -0,0 +1,121 @@
+#include <cstdio>
+#include <iostream>
+
+#include "TFile.h"
+#include "TTimeStamp.h"
+#include "TVirtualMutex.h"
+
+#include "SusyCommon/SusyProgress.h"
+
+using namespace std;
+
+// Serializes the output of the reporters, created once threads are enabled
+static TVirtualMutex* gProgressMutex = 0;
+
+/*--------------------------------------------------------------------------------*/
+// Wall clock in seconds
+/*--------------------------------------------------------------------------------*/
+static double wallTime()
+{
+  return TTimeStamp().AsDouble();
+}
+/*--------------------------------------------------------------------------------*/
+// Format a duration as h:mm:ss
+/*--------------------------------------------------------------------------------*/
+static void formatTime(char* buf, size_t size, double seconds)
+{
+  long sec = long(seconds + 0.5);
+  snprintf(buf, size, "%ld:%02ld:%02ld", sec/3600, (sec/60)%60, sec%60);
+}
+
+/*--------------------------------------------------------------------------------*/
+// SusyProgress Constructor
+/*--------------------------------------------------------------------------------*/
+SusyProgress::SusyProgress(string name, Long64_t interval) :
+        m_name(name),
+        m_interval(interval),
+        m_total(0),
+        m_countPass(false)
+{
+  start();
+}
+
+/*--------------------------------------------------------------------------------*/
+// Reset the counters and start the clock
+/*--------------------------------------------------------------------------------*/
+void SusyProgress::start()
+{
+  m_nEntries    = 0;
+  m_nPass       = 0;
+  m_nextReport  = m_interval > 0? m_interval : -1;
+  m_startTime   = wallTime();
+  m_startBytes  = TFile::GetFileBytesRead();
+  m_lastTime    = m_startTime;
+  m_lastEntries = 0;
+}
+
+/*--------------------------------------------------------------------------------*/
+// Progress line
+/*--------------------------------------------------------------------------------*/
+void SusyProgress::report()
+{
+  double now = wallTime();
+  double elapsed = now - m_startTime;
+  double rate = elapsed > 0? m_nEntries / elapsed : 0;
+  double instRate = now > m_lastTime? (m_nEntries - m_lastEntries) / (now - m_lastTime) : 0;
+  // Bytes read by all the files of the process, shared between threads
+  double mBytes = (TFile::GetFileBytesRead() - m_startBytes) / 1024. / 1024.;
+
+  char line[512];
+  int len = snprintf(line, sizeof(line), "**** %s entry %lld", m_name.c_str(), m_nEntries);
+  if(m_total > 0){
+    len += snprintf(line + len, sizeof(line) - len, "/%lld (%.1f%%)",
+                    m_total, 100. * m_nEntries / m_total);
+  }
+  len += snprintf(line + len, sizeof(line) - len, " rate %.1f Hz (avg %.1f Hz) read %.1f MB",
+                  instRate, rate, mBytes);
+  if(m_countPass){
+    len += snprintf(line + len, sizeof(line) - len, " pass %.2f%%",
+                    m_nEntries > 0? 100. * m_nPass / m_nEntries : 0.);
+  }
+  if(m_total > m_nEntries && rate > 0){
+    char eta[32];
+    formatTime(eta, sizeof(eta), (m_total - m_nEntries) / rate);
+    snprintf(line + len, sizeof(line) - len, " ETA %s", eta);
+  }
+  print(line);
+
+  m_lastTime = now;
+  m_lastEntries = m_nEntries;
+  m_nextReport = m_nEntries + m_interval;
+}
+
+/*--------------------------------------------------------------------------------*/
+// Totals of the loop
+/*--------------------------------------------------------------------------------*/
+void SusyProgress::summary()
+{
+  double elapsed = wallTime() - m_startTime;
+  double mBytes = (TFile::GetFileBytesRead() - m_startBytes) / 1024. / 1024.;
+  char time[32];
+  formatTime(time, sizeof(time), elapsed);
+
+  char line[512];
+  int len = snprintf(line, sizeof(line), "**** %s done: %lld entries in %s, %.1f Hz, read %.1f MB",
+                     m_name.c_str(), m_nEntries, time,
+                     elapsed > 0? m_nEntries / elapsed : 0., mBytes);
+  if(m_countPass){
+    snprintf(line + len, sizeof(line) - len, ", %lld passed (%.2f%%)",
+             m_nPass, m_nEntries > 0? 100. * m_nPass / m_nEntries : 0.);
+  }
+  print(line);
+}
+
+/*--------------------------------------------------------------------------------*/
+// Write a line, one thread at a time
+/*--------------------------------------------------------------------------------*/
+void SusyProgress::print(const char* line)
+{
+  R__LOCKGUARD2(gProgressMutex);
+  cout << line << endl;
+}
@@ -0,0 +1,228 @@
+#include "TThread.h"
+#include "TMutex.h"
+
+#include "SusyCommon/SusyThreadedLooper.h"
+#include "SusyCommon/ChainEntryCache.h"
+
+using namespace std;
+
+/*--------------------------------------------------------------------------------*/
+// SusyThreadedLooper Constructor
+/*--------------------------------------------------------------------------------*/
+SusyThreadedLooper::SusyThreadedLooper(string treeName, string fileList) :
+        m_treeName(treeName),
+        m_fileList(fileList),
+        m_entryCache(""),
+        m_blockSize(2000),
+        m_dbg(0)
+{
+}
+/*--------------------------------------------------------------------------------*/
+// Destructor
+/*--------------------------------------------------------------------------------*/
+SusyThreadedLooper::~SusyThreadedLooper()
+{
+  for(uint i=0; i<m_threads.size(); i++) delete m_threads[i];
+  for(uint i=0; i<m_tasks.size(); i++) delete m_tasks[i].chain;
+  for(uint i=0; i<m_queueMutexes.size(); i++) delete m_queueMutexes[i];
+}
+
+/*--------------------------------------------------------------------------------*/
+// Run the job
+/*--------------------------------------------------------------------------------*/
+int SusyThreadedLooper::run(Long64_t nEvt, Long64_t nSkip)
+{
+  uint nThreads = m_selectors.size();
+  if(nThreads == 0){
+    cout << "SusyThreadedLooper::run ERROR - no selectors" << endl;
+    return 1;
+  }
+
+  // ROOT needs to know that it is running multithreaded before any thread starts
+  TThread::Initialize();
+
+  // Cut the entries in blocks
+  if(makeBlocks(nSkip, nSkip + nEvt)) return 1;
+  uint nBlocks = m_blocks.size();
+  cout << "SusyThreadedLooper : " << nBlocks << " blocks for " << nThreads << " threads" << endl;
+
+  // Deal the blocks in contiguous runs, so that each thread starts on its own files
+  for(uint i=0; i<nThreads; i++){
+    m_queues.push_back(deque<int>());
+    m_queueMutexes.push_back(new TMutex());
+    uint begin = nBlocks*i/nThreads;
+    uint end   = nBlocks*(i+1)/nThreads;
+    for(uint iBlock=begin; iBlock<end; iBlock++) m_queues[i].push_back(iBlock);
+  }
+
+  // Build one chain per thread
+  for(uint i=0; i<nThreads; i++){
+    Task task;
+    task.looper     = this;
+    task.thread     = i;
+    task.selector   = m_selectors[i];
+    task.chain      = new TChain(m_treeName.c_str());
+    task.nProcessed = 0;
+    task.nBlocks    = 0;
+    task.nStolen    = 0;
+    if(ChainEntryCache::addFileList(task.chain, m_fileList, m_entryCache)) return 1;
+    m_tasks.push_back(task);
+  }
+
+  // Begin and Init in the main thread, in order, so that the tool owner comes first
+  for(uint i=0; i<nThreads; i++){
+    Task& task = m_tasks[i];
+    task.selector->Begin(0);
+    task.selector->Init(task.chain);
+    task.chain->SetNotify(task.selector);
+  }
+
+  // Event loops
+  for(uint i=0; i<nThreads; i++){
+    TThread* thread = new TThread(Form("SusyThreadedLooper%i", i), processTask, &m_tasks[i]);
+    m_threads.push_back(thread);
+    thread->Run();
+  }
+  for(uint i=0; i<nThreads; i++) m_threads[i]->Join();
+
+  // Terminate in the main thread, the tool owner last since it deletes the shared tools
+  Long64_t nProcessed = 0;
+  for(int i=nThreads-1; i>=0; i--){
+    Task& task = m_tasks[i];
+    cout << "SusyThreadedLooper : thread " << i << " processed " << task.nProcessed
+         << " entries in " << task.nBlocks << " blocks, " << task.nStolen << " stolen" << endl;
+    nProcessed += task.nProcessed;
+    task.selector->Terminate();
+  }
+
+  int err = 0;
+  if(nProcessed != nEvt){
+    cout << "SusyThreadedLooper::run ERROR - processed " << nProcessed
+         << " of " << nEvt << " entries" << endl;
+    err = 1;
+  }
+  return err;
+}
+
+/*--------------------------------------------------------------------------------*/
+// Cut the entries in blocks following the clusters of each input tree
+/*--------------------------------------------------------------------------------*/
+int SusyThreadedLooper::makeBlocks(Long64_t first, Long64_t last)
+{
+  // A separate chain, so that the selector chains start with no tree loaded and
+  // call Notify on their first entry
+  TChain chain(m_treeName.c_str());
+  if(ChainEntryCache::addFileList(&chain, m_fileList, m_entryCache)) return 1;
+
+  Long64_t entry = first;
+  while(entry < last){
+    Long64_t localEntry = chain.LoadTree(entry);
+    if(localEntry < 0){
+      cout << "SusyThreadedLooper::makeBlocks ERROR - cannot load entry " << entry << endl;
+      return 1;
+    }
+    TTree* tree = chain.GetTree();
+    Long64_t offset = entry - localEntry;
+    Long64_t treeEnd = offset + tree->GetEntries();
+    if(treeEnd > last) treeEnd = last;
+
+    TTree::TClusterIterator clusters = tree->GetClusterIterator(localEntry);
+    Long64_t clusterStart;
+    while(entry < treeEnd && (clusterStart = clusters()) < tree->GetEntries()){
+      Long64_t clusterEnd = offset + clusters.GetNextEntry();
+      if(clusterEnd > treeEnd) clusterEnd = treeEnd;
+      if(clusterEnd <= entry) break;
+      // Blocks never straddle a cluster, large clusters are split evenly
+      Long64_t nInCluster = clusterEnd - entry;
+      Long64_t nSplit = (nInCluster + m_blockSize - 1) / m_blockSize;
+      for(Long64_t iSplit=0; iSplit<nSplit; iSplit++){
+        Block block;
+        block.first      = entry + nInCluster*iSplit/nSplit;
+        block.nEntries   = entry + nInCluster*(iSplit+1)/nSplit - block.first;
+        block.thread     = -1;
+        block.outFirst   = 0;
+        block.outEntries = 0;
+        m_blocks.push_back(block);
+      }
+      entry = clusterEnd;
+    }
+    entry = treeEnd;
+  }
+
+  if(m_dbg){
+    for(uint i=0; i<m_blocks.size(); i++){
+      cout << "SusyThreadedLooper : block " << i << " entries " << m_blocks[i].first
+           << " - " << m_blocks[i].first + m_blocks[i].nEntries - 1 << endl;
+    }
+  }
+  return 0;
+}
+
+/*--------------------------------------------------------------------------------*/
+// Next block for a thread
+/*--------------------------------------------------------------------------------*/
+int SusyThreadedLooper::nextBlock(int thread, bool& stolen)
+{
+  stolen = false;
+  {
+    TLockGuard lock(m_queueMutexes[thread]);
+    deque<int>& queue = m_queues[thread];
+    if(!queue.empty()){
+      int iBlock = queue.front();
+      queue.pop_front();
+      return iBlock;
+    }
+  }
+
+  // Own queue is empty, steal the last block of the longest queue. The sizes
+  // can change while looking, so retry until all queues are seen empty
+  while(true){
+    int victim = -1;
+    uint victimSize = 0;
+    for(uint i=0; i<m_queues.size(); i++){
+      TLockGuard lock(m_queueMutexes[i]);
+      if(m_queues[i].size() > victimSize){
+        victim = i;
+        victimSize = m_queues[i].size();
+      }
+    }
+    if(victim < 0) return -1;
+
+    TLockGuard lock(m_queueMutexes[victim]);
+    deque<int>& queue = m_queues[victim];
+    if(!queue.empty()){
+      int iBlock = queue.back();
+      queue.pop_back();
+      stolen = true;
+      return iBlock;
+    }
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+// Thread function, processes the blocks with SusyD3PDInterface::ProcessBatch
+/*--------------------------------------------------------------------------------*/
+void* SusyThreadedLooper::processTask(void* arg)
+{
+  Task* task = (Task*) arg;
+  SusyThreadedLooper* looper = task->looper;
+
+  bool stolen;
+  int iBlock;
+  while(task->selector->GetAbort() == TSelector::kContinue &&
+        (iBlock = looper->nextBlock(task->thread, stolen)) >= 0){
+    // Each block is only ever touched by the thread which took it
+    Block& block = looper->m_blocks[iBlock];
+    block.thread   = task->thread;
+    block.outFirst = task->selector->getOutputEntries();
+    // Blocks never straddle two trees. LoadTree calls the selector Notify when
+    // the chain moves to a new file
+    Long64_t localEntry = task->chain->LoadTree(block.first);
+    if(localEntry < 0) break;
+    task->nProcessed += task->selector->ProcessBatch(localEntry, block.nEntries);
+    block.outEntries = task->selector->getOutputEntries() - block.outFirst;
+    task->nBlocks++;
+    if(stolen) task->nStolen++;
+  }
+  return 0;
+}
@@ -0,0 +1,62 @@
+#ifndef SusyCommon_ChainEntryCache_h
+#define SusyCommon_ChainEntryCache_h
+
+
+#include <string>
+#include <map>
+
+#include "TChain.h"
+
+/// ChainEntryCache - on-disk cache of the number of entries of the input files
+/**
+   TChain::GetEntries opens every file of the chain to count its entries, which
+   is slow for long file lists on shared filesystems. This cache remembers the
+   entries of each file, keyed by path, tree name, size and modification time,
+   and adds the files to the chain with their entries so that they are only
+   opened when the chain reaches them. Files which are not in the cache, or
+   which changed, are counted once and added to the cache. Files without
+   entries are not added to the chain.
+
+   The cache is a text file with one line per file:
+     path treeName size mtime entries
+ */
+class ChainEntryCache
+{
+
+  public:
+
+    ChainEntryCache(std::string cacheFile);
+
+    // Add a single root file or the files of a file list to the chain. Returns 0 on success.
+    int addFileList(TChain* chain, std::string fileList);
+
+    // Write the cache back if it has changed. Returns 0 on success.
+    int save();
+
+    // One call version of the above. Without cache file, falls back to ChainHelper.
+    static int addFileList(TChain* chain, std::string fileList, std::string cacheFile);
+
+  protected:
+
+    // Add one file to the chain
+    int addFile(TChain* chain, std::string fileName);
+    // Add a file with known entries to the chain
+    void addCounted(TChain* chain, std::string fileName, Long64_t entries);
+
+    struct FileInfo
+    {
+      Long64_t          size;           // file size
+      Long_t            mtime;          // modification time
+      Long64_t          entries;        // tree entries
+    };
+
+    std::string                         m_cacheFile;    // cache file name
+    std::map<std::string, FileInfo>     m_files;        // key: path and tree name
+    bool                                m_changed;      // new entries to be saved
+    int                                 m_nHits;        // files found in the cache
+    int                                 m_nMiss;        // files counted
+    int                                 m_nEmpty;       // files without entries, not added
+
+};
+
+#endif
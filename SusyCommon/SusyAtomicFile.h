@@ -0,0 +1,48 @@
+#ifndef SusyCommon_SusyAtomicFile_h
+#define SusyCommon_SusyAtomicFile_h
+
+
+#include <fstream>
+#include <string>
+
+/// SusyAtomicFile - output file which only appears once it is complete
+/**
+   The content is written to a temporary file, <file>.tmp<pid>, which commit()
+   renames to the file name once the stream is closed without error. Concurrent
+   jobs reading the file therefore never see a partial one, and a short write
+   (quota, full disk) leaves the previous file untouched. The temporary file is
+   removed when the write fails or the object is destroyed without a commit.
+
+   Used for the caches shared between jobs: the chain entry cache, the event
+   index and the compiled GRL.
+ */
+class SusyAtomicFile
+{
+
+  public:
+
+    SusyAtomicFile(std::string fileName, bool binary=false);
+    ~SusyAtomicFile();
+
+    // Whether the temporary file could be created
+    bool isOpen() { return m_out.is_open(); }
+    // Stream of the temporary file
+    std::ofstream& stream() { return m_out; }
+
+    // Close the temporary file and rename it to the file name, checking the
+    // stream first. Returns 0 on success
+    int commit();
+
+    std::string fileName() { return m_fileName; }
+    std::string tmpName() { return m_tmpName; }
+
+  protected:
+
+    std::string         m_fileName;     // final file name
+    std::string         m_tmpName;      // temporary file name
+    std::ofstream       m_out;          // stream of the temporary file
+    bool                m_committed;    // renamed to the final name
+
+};
+
+#endif
@@ -4,13 +4,15 @@
 
 #include <iostream>
 
-#include "GoodRunsLists/TGoodRunsList.h"
-#include "GoodRunsLists/TGoodRunsListReader.h"
 #include "SUSYTools/SUSYObjDef.h"
 #include "SUSYTools/FakeMetEstimator.h"
 #include "SUSYTools/SUSYCrossSection.h"
 #include "SUSYTools/HforToolD3PD.h"
-#include "PileupReweighting/TPileupReweighting.h"
+#include "SusyCommon/SusyPileupWeights.h"
+#include "SusyCommon/SusyGoodRunsList.h"
+#include "SusyCommon/SusyKinematics.h"
+#include "SusyCommon/SusyOverlapRemoval.h"
+#include "SusyCommon/SusyObjectFlags.h"
 #include "LeptonTruthTools/RecoTauMatch.h"
 
 #include "MultiLep/LeptonInfo.h"
@@ -21,6 +23,8 @@
 
 #include "SusyCommon/SusyD3PDInterface.h"
 
+class TVirtualMutex;
+
 /// a class for performing object selections and event cleaning on susy d3pds
 class SusyD3PDAna : public SusyD3PDInterface
 {
@@ -33,10 +37,52 @@ class SusyD3PDAna : public SusyD3PDInterface
     
     // Begin is called before looping on entries
     virtual void    Begin(TTree *tree);
+    // Called at the first entry of a new file, resolves the per-file constants
+    virtual Bool_t  Notify();
     // Main event loop function
     virtual Bool_t  Process(Long64_t entry);
+    // Moves to a new entry, forgets the memoized event quantities
+    virtual Int_t   GetEntry(Long64_t e, Int_t getall = 0);
+    // Process a block of entries, the event level quantities are filled for the
+    // whole block first, see fillBatch
+    virtual Long64_t ProcessBatch(Long64_t firstEntry, Long64_t nEntries);
     // Terminate is called after looping is finished
     virtual void    Terminate();
+    // Options deciding the branches read: data/MC, sys, truth, taus, photons
+    virtual std::string branchConfig();
+
+    //
+    // Tools which are only read in the event loop (electron SF, xsec, GRL, pileup).
+    // Selectors running in several threads can share the tools of one owner.
+    //
+
+    // Initialize the read-only tools, called in Begin
+    void initSharedTools();
+    // Use the tools of the owner, which must run Begin before this selector
+    void setToolOwner(SusyD3PDAna* owner);
+
+    // Tools initialized in Begin, the time of each is reported
+    enum InitTool {
+      INIT_SUSYOBJ = 0,         // SUSYObjDef
+      INIT_FAKEMET,             // fake met estimator
+      INIT_ELESF,               // electron medium SF tool
+      INIT_XSEC,                // SUSY cross section db, MC only
+      INIT_GRL,                 // good runs list, data only
+      INIT_PILEUP,              // pileup reweighting, MC only
+      N_INIT_TOOLS
+    };
+
+    //
+    // Tool reuse between samples processed one after the other by the same selector.
+    // Begin only initializes the tools when toolConfigKey changed since the last sample.
+    //
+
+    // Configuration the tools depend on: MC flag, AF2, MC production, D3PD tag and GRL
+    std::string toolConfigKey();
+    // Keep the tools in Terminate for the next sample
+    void setKeepTools(bool keep=true) { m_keepTools = keep; }
+    // Finalize and delete the tools
+    void releaseTools();
 
     //
     // Object selection
@@ -50,41 +96,156 @@ class SusyD3PDAna : public SusyD3PDInterface
       selectSignalObjects();
       if(m_selectTruth) selectTruthObjects();
     }
-    void selectBaselineObjects(SusyNtSys sys = NtSys_NOM);
+    // Baseline selection; only the collections in the mask are recalibrated and
+    // preselected, the others keep their flags and kinematics
+    void selectBaselineObjects(SusyNtSys sys = NtSys_NOM, uint collections = RECO_COLLECTIONS);
     void selectSignalObjects();
+    // Overlap removal on the kinematics table, see SusyOverlapRemoval
     void performOverlapRemoval();
+    // Chained MultiLep overlap_removal calls
+    void performOverlapRemovalLegacy();
     void selectSignalPhotons();
     void selectTruthObjects();
 
     // MissingEt
     void buildMet(SusyNtSys sys = NtSys_NOM);
 
+    //
+    // Systematics
+    //
+
+    // Systematic enum checks
+    static bool isElecSys(SusyNtSys s){
+      return (s == NtSys_EES_Z_UP   || s == NtSys_EES_Z_DN ||
+	      s == NtSys_EES_MAT_UP || s == NtSys_EES_MAT_DN ||
+	      s == NtSys_EES_PS_UP  || s == NtSys_EES_PS_DN ||
+	      s == NtSys_EES_LOW_UP || s == NtSys_EES_LOW_DN ||
+	      s == NtSys_EER_UP     || s == NtSys_EER_DN);
+    };
+    static bool isMuonSys(SusyNtSys s){
+      return (s == NtSys_MS_UP || s == NtSys_MS_DN || s == NtSys_ID_UP || s == NtSys_ID_DN);
+    };
+    static bool isJetSys(SusyNtSys s){
+      return (s == NtSys_JES_UP || s == NtSys_JES_DN || s == NtSys_JER);
+    };
+    static bool isTauSys(SusyNtSys s){
+      return (s == NtSys_TES_UP || s == NtSys_TES_DN);
+    }
+
+    // Reco collections in a mask of collections, bits 1 << SusyKinematics::Collection
+    static const uint RECO_COLLECTIONS = (1u << SusyKinematics::ELE) | (1u << SusyKinematics::MUO) |
+                                         (1u << SusyKinematics::JET) | (1u << SusyKinematics::TAU);
+    // Collections recalibrated by a systematic. The overlap removal, the signal
+    // selection and the lepton infos depend on all of them, and the MET depends
+    // on all of them and on the soft term variations
+    static uint sysCollections(SusyNtSys sys);
+
+    // Object selection and MET of a systematic, after the nominal ones or the
+    // ones of another systematic. Only the collections whose calibration
+    // differs from the current one are recalibrated and preselected, then the
+    // steps depending on them are redone; the soft term variations only
+    // rebuild the MET. The truth objects are kept
+    void reselectObjects(SusyNtSys sys);
+    // Reset and select everything for each systematic, like the nominal selection
+    void setFullSysReselection(bool full=true) { m_fullSysReselection = full; }
+    // Validation: also reselect everything for each systematic and abort if the
+    // result differs from the reselection. Costs more than the full reselection
+    void setValidateSysReselection(bool validate=true) { m_validateSysReselection = validate; }
+    // Selection lists, kinematics and MET of the current selection in one array
+    void getSelection(std::vector<double>& selection);
+
     // Clear object selection
     void clearObjects();
 
+    // Fill the kinematics table from the calibrated TLVs of the preselected objects
+    // of the collections in the mask
+    void fillKinematics(uint collections = RECO_COLLECTIONS);
+    // Refill one object, e.g. after its TLV was reset to nominal
+    void fillKinematics(SusyKinematics::Collection c, int i);
+    // Kinematics of the current event and systematic
+    const SusyKinematics& kinematics() { return m_kin; }
+
+    // Selection flags of the current event and systematic
+    const SusyObjectFlags& objectFlags() { return m_objs; }
+
+    // Index lists of the selected objects, views of the object flags
+    const std::vector<int>& contTaus()      { return m_objs.objects(SusyKinematics::TAU, SusyObjectFlags::OBJ_CONT); }
+    const std::vector<int>& preElectrons()  { return m_objs.objects(SusyKinematics::ELE, SusyObjectFlags::OBJ_PRE); }
+    const std::vector<int>& preMuons()      { return m_objs.objects(SusyKinematics::MUO, SusyObjectFlags::OBJ_PRE); }
+    const std::vector<int>& preJets()       { return m_objs.objects(SusyKinematics::JET, SusyObjectFlags::OBJ_PRE); }
+    const std::vector<int>& preTaus()       { return m_objs.objects(SusyKinematics::TAU, SusyObjectFlags::OBJ_PRE); }
+    const std::vector<int>& metMuons()      { return m_objs.objects(SusyKinematics::MUO, SusyObjectFlags::OBJ_METMU); }
+    const std::vector<int>& baseElectrons() { return m_objs.objects(SusyKinematics::ELE, SusyObjectFlags::OBJ_BASE); }
+    const std::vector<int>& baseMuons()     { return m_objs.objects(SusyKinematics::MUO, SusyObjectFlags::OBJ_BASE); }
+    const std::vector<int>& baseJets()      { return m_objs.objects(SusyKinematics::JET, SusyObjectFlags::OBJ_BASE); }
+    const std::vector<int>& baseTaus()      { return m_objs.objects(SusyKinematics::TAU, SusyObjectFlags::OBJ_BASE); }
+    const std::vector<int>& sigElectrons()  { return m_objs.objects(SusyKinematics::ELE, SusyObjectFlags::OBJ_SIG); }
+    const std::vector<int>& sigMuons()      { return m_objs.objects(SusyKinematics::MUO, SusyObjectFlags::OBJ_SIG); }
+    const std::vector<int>& sigJets()       { return m_objs.objects(SusyKinematics::JET, SusyObjectFlags::OBJ_SIG); }
+    const std::vector<int>& sigTaus()       { return m_objs.objects(SusyKinematics::TAU, SusyObjectFlags::OBJ_SIG); }
+    const std::vector<int>& sigPhotons()    { return m_objs.objects(SusyKinematics::PHO, SusyObjectFlags::OBJ_SIG); }
+
 
     //
     // Trigger - check matching for all baseline leptons
     //
     void resetTriggers(){
       m_evtTrigFlags = 0;
-      m_eleTrigFlags.clear();
-      m_muoTrigFlags.clear();
-      m_tauTrigFlags.clear();
+      m_objs.clear(SusyObjectFlags::OBJ_TRIG);
     }
     void matchTriggers(){
+      resetTriggers();
       fillEventTriggers();
       matchElectronTriggers();
       matchMuonTriggers();
       matchTauTriggers();
     }
     void fillEventTriggers();
+
+    //
+    // Batch processing
+    //
+
+    // Fill the event cleaning flags, good vertex counts, trigger flags and
+    // generator weights of a block of entries, one stage at a time so that each
+    // stage reads its branches over the whole block in a tight loop.
+    // Until clearBatch, the per-event methods return the batch values.
+    void fillBatch(Long64_t firstEntry, Long64_t nEntries);
+    // Whether the selector drops the events failing the event info cleaning,
+    // the batch then skips their vertex and trigger stages
+    virtual bool filterEventInfo() { return false; }
+    void clearBatch() { m_batch.first = -1; m_batch.n = 0; }
+    // Index of the current entry in the batch, -1 if it is not in the batch
+    int batchIndex() {
+      Long64_t i = m_entry - m_batch.first;
+      return (m_batch.first >= 0 && i >= 0 && i < m_batch.n)? i : -1;
+    }
+
+    //
+    // Event memo: derived event quantities are computed on their first use in
+    // an entry and reused until the next GetEntry, across the systematics too.
+    //
+
+    // Memoized quantities
+    enum MemoItem {
+      MEMO_NGOODVTX = 0,        // getNumGoodVtx
+      MEMO_HFOR,                // getHFORDecision
+      MEMO_FINALSTATE,          // getSusyFinalState
+      MEMO_RANDOMRUNLB,         // calcRandomRunLB
+      MEMO_PILEUP,              // getPileupWeights
+      N_MEMO_ITEMS
+    };
+    // Print the hits and misses of each item
+    void printMemoStats();
+    // The offline eta and phi are taken from the kinematics table
     void matchElectronTriggers();
-    bool matchElectronTrigger(const TLorentzVector* lv, std::vector<int>* trigBools);
+    bool matchElectronTrigger(double eta, double phi, std::vector<int>* trigBools);
     void matchMuonTriggers();
-    bool matchMuonTrigger(const TLorentzVector* lv, std::vector<int>* trigBools);
+    // Needs the features unpacked by flattenMuonTriggerFeatures for this event
+    bool matchMuonTrigger(double eta, double phi, std::vector<int>* trigBools);
+    void flattenMuonTriggerFeatures();
     void matchTauTriggers();
-    bool matchTauTrigger(const TLorentzVector* lv, std::vector<int>* trigBools);
+    bool matchTauTrigger(double eta, double phi, std::vector<int>* trigBools);
 
 
 
@@ -94,7 +255,7 @@ class SusyD3PDAna : public SusyD3PDInterface
 
     // grl
     void setGRLFile(TString fileName) { m_grlFileName = fileName; }
-    bool passGRL() { return m_isMC || m_grl.HasRunLumiBlock(d3pd.evt.RunNumber(), d3pd.evt.lbn()); }
+    bool passGRL() { return m_isMC || m_grl.hasRunLumiBlock(d3pd.evt.RunNumber(), d3pd.evt.lbn()); }
     // incomplete TTC event veto
     bool passTTCVeto() { return (d3pd.evt.coreFlags() & 0x40000) == 0; }
     // Tile error
@@ -128,6 +289,10 @@ class SusyD3PDAna : public SusyD3PDInterface
 
     // Event level cleaning cuts
     void checkEventCleaning();
+    // Event level cleaning cuts which only read the event info (GRL, TTC, LAr, Tile)
+    void checkEventInfoCleaning();
+    // Primary vertex cut
+    void checkVertexCleaning();
     // Object level cleaning cuts; these depend on sys
     void checkObjectCleaning();
 
@@ -146,7 +311,9 @@ class SusyD3PDAna : public SusyD3PDInterface
     // MC weight corresponding to A-B dataset (5.83/fb)
     float getEventWeightAtoB();
 
-    // event weight (xsec*kfac) 
+    // generator event weight
+    float getGenWeight();
+    // event weight (xsec*kfac*eff), resolved once per file
     float getXsecWeight();
     // lumi weight (lumi/sumw) normalized to 4.7/fb
     float getLumiWeight();
@@ -159,6 +326,8 @@ class SusyD3PDAna : public SusyD3PDInterface
     // user cross section uncert
     void setErrXsec(float err) { m_errXsec = err; }
 
+    // pileup weights of all the variants, with one lookup
+    SusyPileupWeights::Weights getPileupWeights();
     // pileup weight for full dataset: currently A-L
     float getPileupWeight();
     float getPileupWeightUp();
@@ -194,6 +363,9 @@ class SusyD3PDAna : public SusyD3PDInterface
     // HF overlap removal decision
     int getHFORDecision();
 
+    // SUSY subprocess of the sparticle pair, only for SUSY samples
+    int getSusyFinalState();
+
     // Count number of good vertices
     uint getNumGoodVtx();
 
@@ -226,6 +398,12 @@ class SusyD3PDAna : public SusyD3PDInterface
     // Toggle tau selection and overlap removal
     void setSelectTaus(bool doIt) { m_selectTaus = doIt; }
 
+    // Use the MultiLep overlap removal instead of SusyOverlapRemoval
+    void setLegacyOverlapRemoval(bool legacy=true) { m_legacyOR = legacy; }
+    // Validation: also run the legacy overlap removal after each one and abort if
+    // the baseline objects differ
+    void setValidateOverlapRemoval(bool validate=true) { m_validateOR = validate; }
+
     // Set-Get truth selection
     void setSelectTruthObjects(bool doIt) { m_selectTruth = doIt; }
     bool getSelectTruthObjects(         ) { return m_selectTruth; }
@@ -252,7 +430,7 @@ class SusyD3PDAna : public SusyD3PDInterface
     bool                        m_isAF2;        // flag for ATLFastII samples
     MCProduction                m_mcProd;       // MC production campaign
 
-    bool                        m_isSusySample; // is susy grid sample
+    bool                        m_isSusySample; // sparticle branches are available in the current file
     int                         m_susyFinalState;// susy subprocess
 
     D3PDTag                     m_d3pdTag;      // SUSY D3PD tag
@@ -267,51 +445,50 @@ class SusyD3PDAna : public SusyD3PDInterface
     //bool                      m_useMetMuons;  // Use appropriate muons for met
 
     //
-    // Object collections (usually just vectors of indices)
+    // Object collections
     //
 
-    // "container" objects pass minimal selection cuts
-    std::vector<int>            m_contTaus;     // container taus
+    // Selection flags of the reco objects, and the trigger matching words.
+    // "container" objects pass minimal selection cuts (taus),
+    // "selected" objects pass kinematic cuts, but no overlap removal applied,
+    // "baseline" objects pass selection + overlap removal,
+    // "signal" objects pass baseline + signal selection (like iso),
+    // met muons are selected muons with a lower pt cut for the met calc.
+    // The index lists are views of the flags, see preElectrons() etc.
+    SusyObjectFlags             m_objs;         // object flags
 
-    // "selected" objects pass kinematic cuts, but no overlap removal applied
-    std::vector<int>            m_preElectrons; // selected electrons
-    std::vector<int>            m_preMuons;     // selected muons
     std::vector<LeptonInfo>     m_preLeptons;   // selected leptons
-    std::vector<int>            m_preJets;      // selected jets
-    std::vector<int>            m_preTaus;      // selected taus
-    std::vector<int>            m_metMuons;     // selected muons with larger eta cut for met calc.
-    
-    // "baseline" objects pass selection + overlap removal
-    std::vector<int>            m_baseElectrons;// baseline electrons
-    std::vector<int>            m_baseMuons;    // baseline muons
     std::vector<LeptonInfo>     m_baseLeptons;  // baseline leptonInfos
-    std::vector<int>            m_baseTaus;     // baseline taus
-    std::vector<int>            m_baseJets;     // baseline jets
-
-    // "signal" objects pass baseline + signal selection (like iso)
-    std::vector<int>            m_sigElectrons; // signal electrons
-    std::vector<int>            m_sigMuons;     // signal muons
     std::vector<LeptonInfo>     m_sigLeptons;   // signal leptonInfos
-    std::vector<int>            m_sigTaus;      // signal taus
-    std::vector<int>            m_sigPhotons;   // signal photons
-    std::vector<int>            m_sigJets;      // signal jets
+
+    SusyKinematics              m_kin;          // kinematics of the preselected objects
+
+    SusyOverlapRemoval          m_overlapRemoval;// overlap removal on m_kin
+    bool                        m_legacyOR;     // use performOverlapRemovalLegacy
+    bool                        m_validateOR;   // compare each overlap removal to the legacy one
 
     // MET
     TLorentzVector              m_met;          // fully corrected MET
 
+    // Systematic reselection
+    SusyNtSys                   m_calibSys[SusyKinematics::N_COLLECTIONS]; // calibration of the SUSYObjDef objects
+    bool                        m_fullSysReselection; // reset and reselect everything for each systematic
+    bool                        m_validateSysReselection; // compare each reselection to the full one
+
     // Truth Objects
     std::vector<int>            m_truParticles; // selected truth particles
     std::vector<int>            m_truJets;      // selected truth jets
     TLorentzVector              m_truMet;       // Truth MET
 
     long long                   m_evtTrigFlags; // Event trigger flags
+    // The object trigger matching words are in m_objs, see SusyObjectFlags::trigFlags
     
-    // Trigger object matching maps
-    // Key: d3pd index, Val: trig bit word
-    std::map<int, long long>    m_eleTrigFlags; // electron trigger matching flags
-    std::map<int, long long>    m_muoTrigFlags; // muon trigger matching flags
-    std::map<int, long long>    m_tauTrigFlags; // tau trigger matching flags
-    
+    // EF muon features unpacked once per event for the trigger matching.
+    // The combined tracks of feature i are [m_muTrigOffset[i], m_muTrigOffset[i+1])
+    std::vector<int>            m_muTrigOffset; // first track of each feature
+    std::vector<double>         m_muTrigEta;    // combined track eta
+    std::vector<double>         m_muTrigPhi;    // combined track phi
+
     //
     // Event quantities
     //
@@ -326,8 +503,61 @@ class SusyD3PDAna : public SusyD3PDInterface
 
     bool                        m_sys;          // True if you want sys for MC, must be set by user. 
 
+    //
+    // Per-file constants, resolved in Notify
+    //
+
+    int                         m_xsecChannel;  // channel number of m_xsecWeight, -1 if not resolved
+    float                       m_xsecWeight;   // xsec*kfactor*efficiency of m_xsecChannel
+
+    // Availability of the trigger branches missing in some D3PDs
+    bool                        m_hasTrig2mu8EFxe40;            // EF_2mu8_EFxe40_tclcw
+    bool                        m_hasTrigMu24j65EFxe40wMu;      // EF_mu24_j65_a4tchad_EFxe40wMu_tclcw
+    bool                        m_hasMuTrig2mu8EFxe40;          // muon EF matching of the above
+    bool                        m_hasMuTrigMu24j65EFxe40wMu;
+    bool                        m_hasMuTrigMu24tight;           // muon EF matching of mu24_tight
+    bool                        m_hasMuTrigMu36tight;           // muon EF matching of mu36_tight
+
     uint                        m_cutFlags;     // Event cleaning cut flags
 
+    // Event level quantities of the current block of entries
+    struct EventBatch
+    {
+      Long64_t                  first;          // first tree entry, -1 if there is no batch
+      Long64_t                  n;              // number of entries
+      std::vector<uint>         cutFlags;       // event info and vertex cleaning flags
+      std::vector<uint>         nGoodVtx;       // number of good vertices
+      std::vector<long long>    trigFlags;      // event trigger flags
+      std::vector<float>        genWeight;      // generator event weight (MC only)
+    };
+    EventBatch                  m_batch;
+
+    // Derived quantities of the current entry
+    struct EventMemo
+    {
+      uint                      valid;          // bit of each MemoItem computed for this entry
+      uint                      nGoodVtx;       // number of good vertices
+      int                       hfor;           // HFOR decision
+      int                       finalState;     // SUSY final state
+      uint                      mcRun;          // random run number
+      uint                      mcLB;           // random lumi block number
+      SusyPileupWeights::Weights pileup;        // pileup weights of all the variants
+      Long64_t                  hits[N_MEMO_ITEMS];
+      Long64_t                  misses[N_MEMO_ITEMS];
+    };
+    EventMemo                   m_memo;
+
+    // Is the item memoized for this entry, counts the hits and misses
+    bool memoHit(MemoItem item) {
+      if(m_memo.valid & (1u << item)){
+        m_memo.hits[item]++;
+        return true;
+      }
+      m_memo.misses[item]++;
+      return false;
+    }
+    void memoSet(MemoItem item) { m_memo.valid |= 1u << item; }
+
     //
     // Tools
     //
@@ -336,17 +566,11 @@ class SusyD3PDAna : public SusyD3PDInterface
     Root::TElectronEfficiencyCorrectionTool* m_eleMediumSFTool;
 
     TString                     m_grlFileName;  // grl file name
-    Root::TGoodRunsList         m_grl;          // good runs list
+    SusyGoodRunsList            m_grl;          // compiled good runs list
 
     FakeMetEstimator            m_fakeMetEst;   // fake met estimator for lar hole veto
 
-    Root::TPileupReweighting*   m_pileup;       // pileup reweighting
-    Root::TPileupReweighting*   m_pileup_up;    // pileup reweighting
-    Root::TPileupReweighting*   m_pileup_dn;    // pileup reweighting
-
-    Root::TPileupReweighting*   m_pileupAB3;    // pileup reweighting for 2012 A-B3 only
-    Root::TPileupReweighting*   m_pileupAB;     // pileup reweighting for 2012 A-B
-    Root::TPileupReweighting*   m_pileupAE;     // pileup reweighting for 2012 A-H (HCP dataset)
+    SusyPileupWeights*          m_pileupWeights;// pileup reweighting, nominal, up, down, A-B3, A-B, A-E
 
     // The SUSY CrossSectionDB has its own map for retrieving xsec info, but
     // it has a lot of entries so lookup is slow.  Save our own xsec map
@@ -360,6 +584,21 @@ class SusyD3PDAna : public SusyD3PDInterface
     PDFTool*                    m_pdfTool;      // PDF reweighting tool (In MultiLep pkg)
     #endif
 
+    SusyD3PDAna*                m_toolOwner;    // owner of the shared tools, 0 if we own them
+    std::string                 m_toolKey;      // toolConfigKey of the initialized tools, "" if none
+    bool                        m_keepTools;    // keep the tools after Terminate
+    TVirtualMutex*              m_toolMutex;    // serializes calls to the shared tools
+
+    // Take the shared tool pointers from the owner
+    void useOwnerTools();
+
+    // Read-only tools of the sample configuration
+    void getSharedTools(std::vector<int>& tools);
+    // Initialize one tool, returns 0 on success
+    int initTool(int tool);
+    // Initialize the tools and report the time of each
+    void initTools(const std::vector<int>& tools);
+
     //RecoTruthMatch            m_recoTruthMatch;       // Lepton truth matching tool
     RecoTauMatch                m_recoTruthMatch;       // Lepton truth matching tool
 
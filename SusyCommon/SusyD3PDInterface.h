@@ -4,6 +4,9 @@
 
 #include <iostream>
 #include <iomanip>
+#include <string>
+#include <vector>
+#include <set>
 
 #include "TSelector.h"
 #include "TTree.h"
@@ -25,6 +28,7 @@
 
 
 #include "SusyNtuple/SusyDefs.h"
+#include "SusyCommon/SusyProgress.h"
 
 
 
@@ -36,6 +40,8 @@ typedef D3PDReader::PhotonD3PDObjectElement PhotonElement;
 typedef D3PDReader::TruthMuonD3PDObjectElement TruthMuonElement;
 typedef D3PDReader::TruthJetD3PDObjectElement TruthJetElement;
 
+class TTreePerfStats;
+
 /// A basic class for holding the D3PDObjects
 class SusyD3PDContainer
 {
@@ -91,7 +97,7 @@ class SusyD3PDInterface : public TSelector
     virtual void    Begin(TTree *tree);
     virtual void    SlaveBegin(TTree *tree){};
     // Called at the first entry of a new file in a chain
-    virtual Bool_t  Notify() { return kTRUE; }
+    virtual Bool_t  Notify();
     // Terminate is called after looping is finished
     virtual void    Terminate();
     virtual void    SlaveTerminate(){};
@@ -102,13 +108,26 @@ class SusyD3PDInterface : public TSelector
 
     // Main event loop function
     virtual Bool_t  Process(Long64_t entry);
+    // Process the entries [firstEntry, firstEntry+nEntries) of the current tree,
+    // returns the number of entries processed. By default Process is called for
+    // each entry, derived classes can first do work over the whole block
+    virtual Long64_t ProcessBatch(Long64_t firstEntry, Long64_t nEntries);
+
+    // Number of entries written to the output so far, used by SusyThreadedLooper
+    // to commit the outputs of its entry blocks in entry order
+    virtual Long64_t getOutputEntries() { return 0; }
 
     // Get entry simply communicates the entry number from TSelector 
     // to this class and hence to all of the VarHandles
     virtual Int_t   GetEntry(Long64_t e, Int_t getall = 0) {
       m_entry=e;
+      if(m_cacheLearning) checkCacheLearning();
       return kTRUE;
     }
+    // Called at the end of Process, once the branches of the entry have been read
+    void endEntry() {
+      if(m_profileBranches && m_entry == m_treeEntries-1) recordBranchUsage();
+    }
 
 
     // Container for D3PD objects - see definition above
@@ -130,17 +149,85 @@ class SusyD3PDInterface : public TSelector
     // Access tree
     TTree* getTree() { return m_tree; }
 
+    //
+    // Input read cache
+    //
+
+    // TTreeCache size in bytes, 0 disables the cache
+    void setCacheSize(Long64_t bytes) { m_cacheSize = bytes; }
+    // Number of entries used to learn which branches are read
+    void setCacheLearnEntries(int n) { m_cacheLearnEntries = n; }
+    // Unzip the baskets of the next cluster in a helper thread while the current one is processed
+    void setReadAhead(bool readAhead=true) { m_readAhead = readAhead; }
+
+    // Print the I/O summary (bytes read, read calls, disk and unzip time)
+    void printIOStats();
+
+    // Progress reporter of the event loop, e.g. to set the interval or the expected entries
+    SusyProgress& progress() { return m_progress; }
+
+    //
+    // Branch usage manifest
+    //
+
+    // Profiling mode: record the branches read during the job and write them to file
+    void setBranchProfile(std::string fileName) { m_profileBranches = true; m_profileFile = fileName; }
+    // Selectors sharing one profile, e.g. the threads of a job, hand their branches
+    // to the owner, which terminates last and writes the union
+    void setBranchProfileOwner(SusyD3PDInterface* owner) { m_profileOwner = owner; }
+    // Production mode: only enable the branches listed in the manifest
+    void setBranchManifest(std::string fileName) { m_manifestFile = fileName; }
+
+    // Job options deciding which branches are read. A manifest is only valid
+    // for the configuration it was profiled with
+    virtual std::string branchConfig();
+
+    // Manifest I/O - one branch name per line, '#' starts a comment. The
+    // profiling configuration is kept in a "# config:" line
+    static bool readBranchManifest(std::string fileName, std::vector<std::string>& branches,
+                                   std::string* config=0);
+    static bool writeBranchManifest(std::string fileName, const std::set<std::string>& branches,
+                                    std::string config="");
+
     ClassDef(SusyD3PDInterface, 1);
 
   protected:
 
+    // Attach the read cache to the current tree
+    void armCache();
+    // Save the learned branches once the training phase is over
+    void checkCacheLearning();
+    // Collect the branches of the current tree that have been read
+    void recordBranchUsage();
+    // Disable every branch not listed in the manifest
+    void applyBranchManifest();
+    // Forget the branches learned by the cache and the recorded branch usage,
+    // when the next sample reads other branches
+    void resetBranchUsage();
+
     TTree* m_tree;              // Current tree
 
     Long64_t m_entry;           // Current entry in the current tree (not chain index!)
+    SusyProgress m_progress;    // Entries processed by this selector and progress reports
 
     int m_dbg;                  // debug level
     bool m_isMC;                // is MC flag
 
+    Long64_t m_cacheSize;       // TTreeCache size in bytes
+    int m_cacheLearnEntries;    // entries used for the cache training phase
+    bool m_cacheLearning;       // cache is still in its training phase
+    std::vector<std::string> m_cacheBranches;   // branches learned by the cache
+    bool m_readAhead;           // use the parallel unzipping cache
+
+    TTreePerfStats* m_ioStats;  // I/O monitoring of the input tree
+
+    Long64_t m_treeEntries;     // entries in the current tree of the chain
+    bool m_profileBranches;     // record the branch usage
+    std::string m_profileFile;  // output manifest of the profiling mode
+    std::string m_manifestFile; // input manifest of the production mode
+    std::set<std::string> m_usedBranches;       // branches read so far
+    SusyD3PDInterface* m_profileOwner;          // selector writing the profile, 0 if this one
+
 };
 
 #endif
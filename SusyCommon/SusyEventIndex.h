@@ -0,0 +1,73 @@
+#ifndef SusyCommon_SusyEventIndex_h
+#define SusyCommon_SusyEventIndex_h
+
+
+#include <string>
+#include <vector>
+
+#include "TChain.h"
+#include "TEventList.h"
+
+/// SusyEventIndex - run/event to entry index of the input files
+/**
+   Each input file gets a sidecar index mapping (RunNumber, EventNumber) to its
+   tree entries, built once by reading only the two event number branches. The
+   index is written next to the file as <file>.evtidx, or in the index directory
+   when one is given (e.g. for remote or read-only inputs), and is rebuilt when
+   the size or modification time of the file changed.
+
+   pickEntries turns a pick list of run/event pairs into a TEventList of chain
+   entries, so that the selector jumps straight to them without reading the
+   other events.
+
+   The index is a binary file: a header (magic, file size, mtime, entries)
+   followed by one record (run, event, entry) per entry, sorted by run and event.
+ */
+class SusyEventIndex
+{
+
+  public:
+
+    SusyEventIndex(std::string indexDir = "");
+
+    // Chain entries of the run/event pairs listed in the pick file, one pair per
+    // line. Returns 0 on error, events which are not found are reported
+    TEventList* pickEntries(TChain* chain, std::string pickFile);
+
+    // Index record of one entry
+    struct Record
+    {
+      UInt_t            run;
+      UInt_t            event;
+      Long64_t          entry;          // entry in the file
+      bool operator<(const Record& r) const {
+        return run < r.run || (run == r.run && event < r.event);
+      }
+    };
+
+    // Read the index of a file, building and saving it when needed. Returns 0 on success
+    int getIndex(std::string fileName, std::string treeName, std::vector<Record>& records);
+
+  protected:
+
+    // Sidecar index file name of an input file
+    std::string indexFileName(std::string fileName);
+    // Read the event numbers of all the entries
+    int buildIndex(std::string fileName, std::string treeName, std::vector<Record>& records);
+
+    // Index file header
+    struct Header
+    {
+      char              magic[8];
+      Long64_t          size;           // input file size
+      Long64_t          mtime;          // input file modification time
+      Long64_t          entries;        // tree entries
+    };
+
+    std::string                 m_indexDir;     // directory of the index files, next to the inputs if empty
+    int                         m_nRead;        // indices read from disk
+    int                         m_nBuilt;       // indices built
+
+};
+
+#endif
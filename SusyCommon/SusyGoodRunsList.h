@@ -0,0 +1,66 @@
+#ifndef SusyCommon_SusyGoodRunsList_h
+#define SusyCommon_SusyGoodRunsList_h
+
+
+#include <string>
+#include <vector>
+
+#include "Rtypes.h"
+
+/// SusyGoodRunsList - compiled good runs list with a binary cache file
+/**
+   The GRL is stored as a sorted array of run numbers and, for each run, a
+   sorted array of disjoint lumi block intervals [begin, end]. A lookup is a
+   binary search on the runs followed by one on the intervals of that run.
+
+   The compiled list is saved in a binary cache file next to the XML
+   (<xml>.bin), which records the size and modification time of the XML.
+   load() reads the cache when it matches the XML and only parses the XML
+   with TGoodRunsListReader when the XML changed, or the cache is missing.
+   The cache is written to a temporary file first so that concurrent jobs
+   never read a partial cache. If it cannot be written, the compiled list is
+   still used for the job.
+
+   Lookups only read the arrays, so a loaded list can be copied to, or shared
+   between, threads.
+ */
+class SusyGoodRunsList
+{
+
+  public:
+
+    SusyGoodRunsList();
+
+    // Load the GRL of an XML file, from the cache when it is up to date. Returns 0 on success
+    int load(std::string xmlFile);
+    // Remove all the runs
+    void clear();
+
+    // Is the lumi block of the run in the list
+    bool hasRunLumiBlock(uint run, uint lb) const;
+    // Is the run in the list
+    bool hasRun(uint run) const { return findRun(run) >= 0; }
+
+    // Number of runs and lumi block intervals
+    uint nRuns() const { return m_runs.size(); }
+    uint nIntervals() const { return m_lbBegin.size(); }
+
+  protected:
+
+    // Index of the run in m_runs, -1 if not found
+    int findRun(uint run) const;
+
+    // Parse the XML into the arrays, returns 0 on success
+    int compile(std::string xmlFile);
+    // Read and write the binary cache, return 0 on success
+    int readCache(std::string cacheFile, Long64_t xmlSize, Long_t xmlMtime);
+    int writeCache(std::string cacheFile, Long64_t xmlSize, Long_t xmlMtime);
+
+    std::vector<uint>   m_runs;         // sorted run numbers
+    std::vector<uint>   m_runOffsets;   // first interval of each run, plus the total at the end
+    std::vector<uint>   m_lbBegin;      // first lumi block of each interval
+    std::vector<uint>   m_lbEnd;        // last lumi block of each interval
+
+};
+
+#endif
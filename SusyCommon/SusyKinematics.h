@@ -0,0 +1,88 @@
+#ifndef SusyCommon_SusyKinematics_h
+#define SusyCommon_SusyKinematics_h
+
+
+#include <vector>
+
+#include "TLorentzVector.h"
+
+/// SusyKinematics - per-event structure-of-arrays table of the object kinematics
+/**
+   Holds pt, eta, phi, E, mass, momentum, charge and cos/sin phi of the objects of each
+   collection, in arrays indexed by the D3PD object index. The table is filled
+   from the calibrated SUSYObjDef TLVs once per event and systematic, right
+   after the preselection, so that overlap removal, trigger matching, the dumps
+   and the SusyNt fills read plain numbers instead of recomputing eta and phi
+   from the TLVs every time.
+
+   The values are the ones of the TLorentzVector methods, and deltaR is
+   computed like TLorentzVector::DeltaR, so the results are identical.
+   Only the objects which were filled have valid entries.
+ */
+class SusyKinematics
+{
+
+  public:
+
+    // Object collections
+    enum Collection {
+      ELE = 0,
+      MUO,
+      JET,
+      TAU,
+      PHO,
+      TRUTHJET,
+      N_COLLECTIONS
+    };
+
+    // Kinematics of one collection
+    struct Table
+    {
+      std::vector<double>       pt;
+      std::vector<double>       eta;
+      std::vector<double>       phi;
+      std::vector<double>       e;
+      std::vector<double>       m;
+      std::vector<double>       px;
+      std::vector<double>       py;
+      std::vector<double>       pz;
+      std::vector<double>       cosPhi;
+      std::vector<double>       sinPhi;
+      std::vector<float>        q;              // charge, 0 for jets and photons
+      std::vector<char>         filled;         // the entry is valid
+    };
+
+    SusyKinematics() {}
+
+    // Empty all the collections, the memory is kept for the next event
+    void clear();
+    // Size a collection for n objects, none filled
+    void reset(Collection c, uint n);
+    // Fill one object from its TLV
+    void fill(Collection c, uint i, const TLorentzVector& lv, float q=0);
+
+    // Number of objects of a collection, filled or not
+    uint size(Collection c) const { return m_tables[c].filled.size(); }
+    bool isFilled(Collection c, uint i) const { return i < size(c) && m_tables[c].filled[i]; }
+    const Table& table(Collection c) const { return m_tables[c]; }
+
+    double pt (Collection c, uint i) const { return m_tables[c].pt[i]; }
+    double eta(Collection c, uint i) const { return m_tables[c].eta[i]; }
+    double phi(Collection c, uint i) const { return m_tables[c].phi[i]; }
+    double e  (Collection c, uint i) const { return m_tables[c].e[i]; }
+    double m  (Collection c, uint i) const { return m_tables[c].m[i]; }
+    float  q  (Collection c, uint i) const { return m_tables[c].q[i]; }
+
+    // DeltaR between two objects, or an object and an eta, phi direction
+    double deltaR(Collection c1, uint i1, Collection c2, uint i2) const {
+      return deltaR(c1, i1, m_tables[c2].eta[i2], m_tables[c2].phi[i2]);
+    }
+    double deltaR(Collection c, uint i, double eta, double phi) const;
+
+  protected:
+
+    Table               m_tables[N_COLLECTIONS];
+
+};
+
+#endif
@@ -3,8 +3,10 @@
 
 
 #include <iostream>
+#include <ctime>
 
 #include "TStopwatch.h"
+#include "TH1D.h"
 
 #include "SusyCommon/SusyD3PDAna.h"
 #include "SusyNtuple/SusyNtObject.h"
@@ -29,6 +31,9 @@ class SusyNtMaker : public SusyD3PDAna
     // Terminate is called after looping is finished
     virtual void    Terminate();
 
+    // Number of events saved in the SusyNt so far
+    virtual Long64_t getOutputEntries() { return n_evt_saved; }
+
     // Event selection - loose object/event cuts for filling tree
     virtual bool    selectEvent();
 
@@ -36,6 +41,12 @@ class SusyNtMaker : public SusyD3PDAna
     TH1F* makeCutFlow(const char* name, const char* title);
     TH1F* getProcCutFlow(int signalProcess);
 
+    // Histogram of the object and event counters, saved in the output so that
+    // the counters of several jobs can be merged with the cutflows
+    TH1D* makeCounterHist();
+    // Reset the object and event counters
+    void resetCounters();
+
     //
     // SusyNt Fill methods
     //
@@ -56,6 +67,15 @@ class SusyNtMaker : public SusyD3PDAna
     void fillTruthJetVars();
     void fillTruthMetVars();
 
+    // Reco truth matching, setup on the first call in each event
+    RecoTauMatch& recoTruthMatch();
+
+    // Truth matching of the saved objects is queued while filling and resolved once
+    // the event passed the filter, so that dropped events never read the tracks
+    enum TruthMatchObj { TruthMatch_Ele = 0, TruthMatch_Muo, TruthMatch_Tau };
+    void queueTruthMatch(TruthMatchObj obj, uint ntIdx, const TLorentzVector& lv);
+    void resolveTruthMatches();
+
     // Systematic Methods
     void doSystematic();
 
@@ -70,33 +90,27 @@ class SusyNtMaker : public SusyD3PDAna
     void addMissingJet(int index, SusyNtSys sys);
     void addMissingTau(int index, SusyNtSys sys);
 
-    // Systematic enum checks
-    bool isElecSys(SusyNtSys s){
-      return (s == NtSys_EES_Z_UP   || s == NtSys_EES_Z_DN ||
-	      s == NtSys_EES_MAT_UP || s == NtSys_EES_MAT_DN ||
-	      s == NtSys_EES_PS_UP  || s == NtSys_EES_PS_DN ||
-	      s == NtSys_EES_LOW_UP || s == NtSys_EES_LOW_DN ||
-	      s == NtSys_EER_UP     || s == NtSys_EER_DN);
-    };
-    bool isMuonSys(SusyNtSys s){
-      return (s == NtSys_MS_UP || s == NtSys_MS_DN || s == NtSys_ID_UP || s == NtSys_ID_DN);
-    };
-    bool isJetSys(SusyNtSys s){
-      return (s == NtSys_JES_UP || s == NtSys_JES_DN || s == NtSys_JER);
-    };
-    bool isTauSys(SusyNtSys s){
-      return (s == NtSys_TES_UP || s == NtSys_TES_DN);
-    }
-
     //void addEventFlag(SusyNtSys s, int eventFlag){
       //m_susyNt.evt()->evtFlag[s] = eventFlag;
     //};
 
     // Toggle SusyNt file writing
     void setFillNt(bool fill=true) { m_fillNt = fill; }
+    // Output file name
+    void setOutputFileName(std::string name) { m_outFileName = name; }
+
+    // Checkpoint the output every nEntries processed entries, 0 to turn off
+    void setCheckpoint(int nEntries) { m_checkpointEntries = nEntries; }
+    // Stop cleanly after this wall clock time in seconds, 0 to turn off
+    void setDeadline(double seconds) { m_deadline = seconds; }
+    // Save the output and the last processed chain entry
+    void writeCheckpoint();
+    // Last chain entry saved in an output file, -1 if there is none
+    static Long64_t readLastEntry(std::string fileName);
 
     // Toggle filtering
     void setFilter(bool filter=true) { m_filter = filter; }
+    virtual bool filterEventInfo() { return m_filter; }
 
     // Set light lepton filter
     void setNLepFilter(uint nLep) { m_nLepFilter = nLep; }
@@ -133,6 +147,7 @@ class SusyNtMaker : public SusyD3PDAna
 
     TFile*              m_outTreeFile;  // output tree file
     TTree*              m_outTree;      // output tree
+    std::string         m_outFileName;  // output file name
 
     Susy::SusyNtObject  m_susyNt;       // SusyNt interface
 
@@ -146,9 +161,20 @@ class SusyNtMaker : public SusyD3PDAna
 
     // Some useful flags
     bool                m_isHsignalSample; ///< either a WH signal sample, or an HLFV signal sample
+    bool                m_isPowhegLfvHsignalSample; ///< Powheg HLFV signal sample, needs the Higgs pT parameters
     int                 m_hDecay;       // higgs decay type (see WhTruthExtractor::Hdecays)
     bool                m_hasSusyProp;  // whether this event is affected by the susy propagator bug (only for c1c1)
 
+    // Truth matching
+    struct TruthMatchQuery
+    {
+      TruthMatchObj     obj;            // object type
+      uint              ntIdx;          // index in the SusyNt collection
+      TLorentzVector    lv;             // reco momentum used for the matching
+    };
+    bool                m_recoTruthMatchReady;  // m_recoTruthMatch is setup for this event
+    std::vector<TruthMatchQuery> m_truthMatchQueries; // queries of the objects filled so far
+
     // Some object counts
     uint                n_base_ele;
     uint                n_base_muo;
@@ -196,6 +222,14 @@ class SusyNtMaker : public SusyD3PDAna
     // Timer
     TStopwatch          m_timer;
 
+    // Checkpointing
+    int                 m_checkpointEntries;    // entries between checkpoints
+    double              m_deadline;     // wall clock limit in seconds
+    time_t              m_startTime;    // start of the event loop
+    Long64_t            m_lastEntry;    // last chain entry processed
+
+    void writeLastEntry();
+
 };
 
 #endif
@@ -0,0 +1,92 @@
+#ifndef SusyCommon_SusyObjectFlags_h
+#define SusyCommon_SusyObjectFlags_h
+
+
+#include <vector>
+
+#include "SusyCommon/SusyKinematics.h"
+
+/// SusyObjectFlags - selection state of the D3PD objects, one flag word per object
+/**
+   Each collection of SusyKinematics has an array of flag words indexed by the
+   D3PD object index, telling which selections the object passed, and an array
+   of trigger matching words.
+
+   The index lists the analysis loops over are views of the flags. A list set
+   with setObjects is kept as the view of its flag, in the order given, which
+   is the order of the MultiLep selection functions. When single flags are
+   changed, the view is rebuilt in index order on its next use. The arrays and
+   views keep their memory between events and systematics, and membership
+   tests only read one word.
+ */
+class SusyObjectFlags
+{
+
+  public:
+
+    typedef SusyKinematics::Collection Collection;
+
+    // Object flags
+    enum ObjectFlag {
+      OBJ_CONT  = 1<<0,         // container object (taus)
+      OBJ_PRE   = 1<<1,         // preselected: kinematic and cleaning cuts
+      OBJ_BASE  = 1<<2,         // baseline: preselected + overlap removal
+      OBJ_SIG   = 1<<3,         // signal: baseline + signal cuts
+      OBJ_METMU = 1<<4,         // muon used in the met
+      OBJ_TRIG  = 1<<5          // matched to at least one trigger, see trigFlags
+    };
+    static const int  N_OBJ_FLAGS   = 6;
+    // Flags of the object selection, reset for each systematic
+    static const uint OBJ_SELECTION = OBJ_CONT | OBJ_PRE | OBJ_BASE | OBJ_SIG | OBJ_METMU;
+
+    SusyObjectFlags();
+
+    // Size a collection for n objects, new objects have no flags
+    void resize(Collection c, uint n);
+    // Clear some flags of all the objects, the memory is kept.
+    // Clearing OBJ_TRIG also clears the trigger matching words
+    void clear(uint flags);
+
+    // Give a flag to the objects of the list, and only to them
+    void setObjects(Collection c, ObjectFlag flag, const std::vector<int>& idx);
+    // Single object updates
+    void setFlag(Collection c, uint i, ObjectFlag flag);
+    void resetFlag(Collection c, uint i, ObjectFlag flag);
+
+    // Flags of an object, 0 for objects beyond the collection size
+    uint flags(Collection c, uint i) const {
+      const std::vector<uint>& words = m_states[c].words;
+      return i < words.size()? words[i] : 0;
+    }
+    bool has(Collection c, uint i, ObjectFlag flag) const { return (flags(c, i) & flag) != 0; }
+
+    // Indices of the objects with a flag. The view is rebuilt when the flags
+    // changed, changes go through the flags
+    const std::vector<int>& objects(Collection c, ObjectFlag flag);
+
+    // Trigger matching word of an object, also sets OBJ_TRIG when it is not 0
+    void setTrigFlags(Collection c, uint i, long long trigFlags);
+    long long trigFlags(Collection c, uint i) const {
+      const std::vector<long long>& trig = m_states[c].trig;
+      return i < trig.size()? trig[i] : 0;
+    }
+
+  protected:
+
+    // Position of a flag in the word
+    static int flagBit(ObjectFlag flag);
+
+    // Flags and views of one collection
+    struct State
+    {
+      std::vector<uint>         words;                  // flag word of each object
+      std::vector<long long>    trig;                   // trigger matching word of each object
+      std::vector<int>          views[N_OBJ_FLAGS];     // objects with each flag
+      bool                      valid[N_OBJ_FLAGS];     // the view matches the flags
+    };
+
+    State                       m_states[SusyKinematics::N_COLLECTIONS];
+
+};
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef SusyCommon_SusyOverlapRemoval_h
+#define SusyCommon_SusyOverlapRemoval_h
+
+
+#include <vector>
+
+#include "SusyCommon/SusyKinematics.h"
+#include "SusyCommon/SusyObjectFlags.h"
+
+/// SusyOverlapRemoval - overlap removal of the preselected objects on the kinematics table
+/**
+   Computes one matrix of DeltaR^2 per pair of collections over the preselected
+   objects, with an AVX2 kernel when the CPU supports it and a scalar kernel
+   otherwise, then applies the steps of the prescription as updates of one
+   survival mask per collection:
+
+     e-e 0.05 (softer one removed), j-e 0.2, tau-e 0.2, tau-mu 0.2, e-j 0.4,
+     mu-j 0.4, e-mu 0.01 (both ways), mu-mu 0.05 (both removed), j-tau 0.2,
+     SFOS e and mu pairs with Mll < 12 GeV (both removed).
+
+   Each step reads the same lists as the chained MultiLep overlap_removal calls,
+   so the baseline lists are the same, in the preselection order. Both kernels
+   do the arithmetic of TLorentzVector::DeltaR without the square root, and the
+   cuts are turned into the equivalent DeltaR^2 thresholds, so the comparisons
+   give the same answers as DeltaR < cut.
+ */
+class SusyOverlapRemoval
+{
+
+  public:
+
+    SusyOverlapRemoval();
+
+    // Set the baseline flags of the preselected objects. The taus are only
+    // used when doTaus, otherwise their baseline flags are left untouched
+    void apply(const SusyKinematics& kin, bool doTaus, SusyObjectFlags& objs);
+
+    // Use the AVX2 kernel, ignored when the CPU does not support it
+    void setUseAvx2(bool useAvx2) { m_useAvx2 = useAvx2 && hasAvx2(); }
+    bool useAvx2() const { return m_useAvx2; }
+    // AVX2 kernel compiled in and supported by the CPU
+    static bool hasAvx2();
+
+    // Smallest DeltaR^2 for which DeltaR = sqrt(DeltaR^2) is not below cut
+    static double dR2Threshold(float cut);
+
+  protected:
+
+    // Eta and phi of a list of objects, contiguous for the kernels
+    struct Coords
+    {
+      std::vector<double>       eta;
+      std::vector<double>       phi;
+    };
+    void gather(const SusyKinematics& kin, SusyKinematics::Collection c,
+                const std::vector<int>& idx, Coords& coords);
+
+    // DeltaR^2 matrix between two lists, row major with one row per object of the first list
+    void fillMatrix(const Coords& c1, const Coords& c2, std::vector<double>& dR2);
+
+    // Clear alive1[i] when object i is closer than the threshold to an object j
+    // of the second list with mask2[j] set. The first list is the rows of the
+    // matrix, or its columns when !rows. With sameType the diagonal is skipped,
+    // and with pt, i is only removed by objects of higher or equal pt
+    void removeOverlaps(const std::vector<double>& dR2, bool rows, double threshold,
+                        std::vector<char>& alive1, const std::vector<char>& mask2,
+                        bool sameType=false, const std::vector<double>* pt=0);
+
+    // Clear both leptons of the opposite sign pairs with Mll below mllCut
+    void removeSFOSPairs(const SusyKinematics& kin, SusyKinematics::Collection c,
+                         const std::vector<int>& idx, std::vector<char>& alive, float mllCut);
+
+    // Give the baseline flag to the objects still alive
+    void select(SusyObjectFlags& objs, SusyKinematics::Collection c,
+                const std::vector<int>& idx, const std::vector<char>& alive);
+
+    bool                        m_useAvx2;
+
+    // Work space, kept between events
+    Coords                      m_ele;
+    Coords                      m_muo;
+    Coords                      m_jet;
+    Coords                      m_tau;
+    std::vector<double>         m_elePt;
+    std::vector<double>         m_dR2EE;
+    std::vector<double>         m_dR2JE;
+    std::vector<double>         m_dR2TE;
+    std::vector<double>         m_dR2TM;
+    std::vector<double>         m_dR2MJ;
+    std::vector<double>         m_dR2EM;
+    std::vector<double>         m_dR2MM;
+    std::vector<double>         m_dR2JT;
+    std::vector<char>           m_eleAlive;
+    std::vector<char>           m_muoAlive;
+    std::vector<char>           m_jetAlive;
+    std::vector<char>           m_tauAlive;
+    std::vector<char>           m_tmpAlive;
+    std::vector<int>            m_selected;
+
+};
+
+#endif
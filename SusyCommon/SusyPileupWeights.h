@@ -0,0 +1,91 @@
+#ifndef SusyCommon_SusyPileupWeights_h
+#define SusyCommon_SusyPileupWeights_h
+
+
+#include <map>
+
+#include "PileupReweighting/TPileupReweighting.h"
+
+/// SusyPileupWeights - all the pileup reweighting variants behind one lookup
+/**
+   Builds the TPileupReweighting tools of every variant from one table of
+   settings (data scale factor and lumicalc file). The weights only depend on
+   (run, channel, mu), and the MC mu values are discrete, so the weights of
+   all the variants are computed together on the first event with a given
+   key and then served from a memo. Each event does one map lookup instead of
+   six GetCombinedWeight calls.
+
+   The memo is not locked, callers sharing the engine between threads must
+   serialize the calls (see SusyD3PDAna::setToolOwner).
+ */
+class SusyPileupWeights
+{
+
+  public:
+
+    // Pileup reweighting variants
+    enum Variant {
+      PU_NOM = 0,       // nominal, A-L lumi
+      PU_UP,            // data scale factor up
+      PU_DN,            // data scale factor down
+      PU_AB3,           // 2012 A-B3 only
+      PU_AB,            // 2012 A-B only
+      PU_AE,            // 2012 A-E only
+      N_PU_VARIANTS
+    };
+
+    // Weights of all the variants
+    struct Weights
+    {
+      float w[N_PU_VARIANTS];
+    };
+
+    SusyPileupWeights();
+    ~SusyPileupWeights();
+
+    // Build and initialize the tools of all the variants, returns 0 on success
+    int initialize();
+
+    // Weights of all the variants for one event
+    const Weights& getWeights(uint run, uint channel, float mu);
+    // Weight of one variant
+    float getWeight(Variant v, uint run, uint channel, float mu) {
+      return getWeights(run, channel, mu).w[v];
+    }
+
+    // Random run and lumi block numbers from the nominal tool
+    // Seed the draws of an event from its run and event numbers, so that they do
+    // not depend on the order in which events (or threads) reach the tool
+    void setRandomSeed(uint run, uint event);
+    uint getRandomRunNumber(uint run);
+    uint getRandomLumiBlockNumber(uint run);
+
+    // Tool of one variant
+    Root::TPileupReweighting* tool(Variant v) { return m_tools[v]; }
+
+    // Print the memo hit rate
+    void printStats();
+
+  protected:
+
+    // Memo key, the exact event values
+    struct Key
+    {
+      uint      run;
+      uint      channel;
+      float     mu;
+      bool operator<(const Key& k) const {
+        if(run != k.run) return run < k.run;
+        if(channel != k.channel) return channel < k.channel;
+        return mu < k.mu;
+      }
+    };
+
+    Root::TPileupReweighting*   m_tools[N_PU_VARIANTS]; // one tool per variant
+    std::map<Key, Weights>      m_memo;         // weights of the keys seen so far
+    Long64_t                    m_nHits;        // lookups served by the memo
+    Long64_t                    m_nMisses;      // lookups computed by the tools
+
+};
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef SusyCommon_SusyProgress_h
+#define SusyCommon_SusyProgress_h
+
+
+#include <string>
+
+#include "Rtypes.h"
+
+/// SusyProgress - event loop progress and throughput reporter of one selector
+/**
+   Counts the processed and passing entries and prints a progress line every
+   N entries with the instantaneous and average event rates, the bytes read,
+   the pass fraction and the estimated time left. Counting is a couple of
+   integer operations, the clock is only read and the line only formatted
+   when a report is due.
+
+   Each selector owns its reporter, so the counters are never shared between
+   threads. The lines are written in one go under a lock, so the reports of
+   several threads do not interleave.
+ */
+class SusyProgress
+{
+
+  public:
+
+    SusyProgress(std::string name="", Long64_t interval=10000);
+
+    // Name printed at the start of each line
+    void setName(std::string name) { m_name = name; }
+    // Entries between two reports, 0 turns the reports off
+    void setInterval(Long64_t interval) {
+      m_interval = interval;
+      m_nextReport = interval > 0? m_nEntries + interval : -1;
+    }
+    // Expected number of entries, used for the ETA. 0 if unknown
+    void setTotal(Long64_t total) { m_total = total; }
+    // Report the fraction of entries passing the selection
+    void setCountPass(bool countPass=true) { m_countPass = countPass; }
+
+    // Reset the counters and start the clock
+    void start();
+
+    // Count one processed entry
+    void count() {
+      if(++m_nEntries == m_nextReport) report();
+    }
+    // Count one entry passing the selection
+    void pass() { m_nPass++; }
+
+    // Number of entries counted so far
+    Long64_t entries() const { return m_nEntries; }
+    // Number of entries passing the selection so far
+    Long64_t passed() const { return m_nPass; }
+
+    // Print a progress line
+    void report();
+    // Print the totals of the loop
+    void summary();
+
+  protected:
+
+    // Write a line to cout, serialized between threads
+    static void print(const char* line);
+
+    std::string         m_name;         // name of the selector
+    Long64_t            m_interval;     // entries between reports
+    Long64_t            m_total;        // expected entries
+    bool                m_countPass;    // the selector counts passing entries
+
+    Long64_t            m_nEntries;     // entries processed
+    Long64_t            m_nPass;        // entries passing the selection
+    Long64_t            m_nextReport;   // entry count of the next report
+
+    double              m_startTime;    // clock at start, in seconds
+    Long64_t            m_startBytes;   // bytes read at start
+    double              m_lastTime;     // clock at the last report
+    Long64_t            m_lastEntries;  // entries at the last report
+
+};
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef SusyCommon_SusyThreadedLooper_h
+#define SusyCommon_SusyThreadedLooper_h
+
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "TChain.h"
+
+#include "SusyCommon/SusyD3PDInterface.h"
+
+class TThread;
+class TMutex;
+
+/// SusyThreadedLooper - runs several selectors on blocks of entries of the same input in threads
+/**
+   The entries are cut in blocks aligned to the TTree clusters of the input
+   files, so that a block never shares baskets with another block. The blocks
+   are dealt in contiguous runs to per-thread queues. A thread takes blocks
+   from the front of its own queue and, once it is empty, steals from the back
+   of the longest other queue, so that threads running on cheap events (e.g.
+   failing the GRL) help the ones running on expensive ones.
+
+   Each block is processed with one SusyD3PDInterface::ProcessBatch call.
+   Each selector gets its own chain built from the file list. The output range
+   written by each block is recorded (see SusyD3PDInterface::getOutputEntries)
+   so that the outputs can be committed in entry order afterwards.
+   Begin and Terminate are called from the main thread, in selector order, so
+   that the first selector can initialize tools which the others share
+   (see SusyD3PDAna::setToolOwner). Only the event loop runs in the threads.
+ */
+class SusyThreadedLooper
+{
+
+  public:
+
+    SusyThreadedLooper(std::string treeName, std::string fileList);
+    ~SusyThreadedLooper();
+
+    // Add a selector, one thread is started for each selector
+    void addSelector(SusyD3PDInterface* selector) { m_selectors.push_back(selector); }
+
+    // Process nEvt entries after skipping nSkip, returns 0 on success
+    int run(Long64_t nEvt, Long64_t nSkip=0);
+
+    // Debug level
+    void setDebug(int dbg) { m_dbg = dbg; }
+    // Entry count cache used to build the chains, see ChainEntryCache
+    void setEntryCache(std::string entryCache) { m_entryCache = entryCache; }
+    // Maximum number of entries in a block, larger clusters are split
+    void setBlockSize(Long64_t blockSize) { m_blockSize = blockSize; }
+
+    // Block of consecutive chain entries
+    struct Block
+    {
+      Long64_t            first;          // first chain entry
+      Long64_t            nEntries;       // number of entries
+      int                 thread;         // thread which processed it, -1 if not done
+      Long64_t            outFirst;       // first output entry written by the block
+      Long64_t            outEntries;     // number of output entries written by the block
+    };
+
+    // Blocks in entry order, filled by run
+    const std::vector<Block>& getBlocks() { return m_blocks; }
+
+    // Work unit of one thread
+    struct Task
+    {
+      SusyThreadedLooper* looper;
+      int                 thread;         // thread index
+      SusyD3PDInterface*  selector;
+      TChain*             chain;
+      Long64_t            nProcessed;     // number of entries processed
+      int                 nBlocks;        // number of blocks processed
+      int                 nStolen;        // number of blocks stolen from other threads
+    };
+
+  protected:
+
+    // Cut the entries [first, last) in cluster aligned blocks
+    int makeBlocks(Long64_t first, Long64_t last);
+    // Next block for a thread, its own queue first then stealing, -1 when all are done
+    int nextBlock(int thread, bool& stolen);
+
+    // Thread function, loops over the blocks handed to one task
+    static void* processTask(void* task);
+
+    std::string                         m_treeName;     // input tree name
+    std::string                         m_fileList;     // input file list
+    std::string                         m_entryCache;   // entry count cache file
+    Long64_t                            m_blockSize;    // max entries in a block
+    std::vector<SusyD3PDInterface*>     m_selectors;    // one selector per thread
+    std::vector<Task>                   m_tasks;        // one task per thread
+    std::vector<TThread*>               m_threads;      // worker threads
+    std::vector<Block>                  m_blocks;       // blocks in entry order
+    std::vector< std::deque<int> >      m_queues;       // block indices, one queue per thread
+    std::vector<TMutex*>                m_queueMutexes; // one mutex per queue
+    int                                 m_dbg;          // debug level
+
+};
+
+#endif
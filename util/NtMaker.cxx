@@ -1,14 +1,30 @@
 
 #include <cstdlib>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
 #include <string>
+#include <vector>
+#include <unistd.h>
+#include <sys/wait.h>
 
 #include "TChain.h"
+#include "TFile.h"
+#include "TH1D.h"
+#include "TFileMerger.h"
+#include "TKey.h"
+#include "TList.h"
+#include "TParameter.h"
 #include "Cintex/Cintex.h"
 #include "TSystem.h"
 
 #include "SusyCommon/SusyNtMaker.h"
+#include "SusyCommon/SusyThreadedLooper.h"
 #include "SusyNtuple/SusyDefs.h"
 #include "SusyNtuple/ChainHelper.h"
+#include "SusyCommon/ChainEntryCache.h"
+#include "SusyCommon/SusyEventIndex.h"
 
 using namespace std;
 using namespace Susy;
@@ -35,6 +51,17 @@ void help()
   cout << "  -f name of input filelist"         << endl;
   cout << "     defaults: fileList.txt"         << endl;
 
+  cout << "  --entryCache file caching the"     << endl;
+  cout << "     entries of the input files"     << endl;
+  cout << "     default: none (count entries)"  << endl;
+
+  cout << "  --pick file of run event pairs,"   << endl;
+  cout << "     only these events are processed"<< endl;
+
+  cout << "  --indexDir directory of the run"   << endl;
+  cout << "     event indices used by --pick"   << endl;
+  cout << "     default: next to the input files"<< endl;
+
   cout << "  -s sample name, sets isMC flag"    << endl;
   cout << "     use e.g. 'ttbar', 'DataG', etc" << endl;
 
@@ -104,10 +131,382 @@ void help()
   cout << "  --filterTrig turns on trigger"     << endl;
   cout << "     filtering."                     << endl;
 
+  cout << "  --cacheSize read cache size in MB" << endl;
+  cout << "     default: 30, 0 disables cache"  << endl;
+
+  cout << "  --cacheLearn number of entries"    << endl;
+  cout << "     used to train the read cache"   << endl;
+  cout << "     default: 100"                   << endl;
+
+  cout << "  --readAhead unzip the next baskets" << endl;
+  cout << "     in a helper thread. Default: off" << endl;
+
+  cout << "  --profileBranches write the list of"<< endl;
+  cout << "     branches read by the job to file" << endl;
+
+  cout << "  --branchManifest only enable the"  << endl;
+  cout << "     branches listed in the file"    << endl;
+
+  cout << "  --jobs number of worker processes"<< endl;
+  cout << "     outputs are merged at the end"  << endl;
+  cout << "     default: 1"                     << endl;
+
+  cout << "  --threads number of event loop"   << endl;
+  cout << "     threads sharing the read-only"  << endl;
+  cout << "     tools. Default: 1"              << endl;
+
+  cout << "  --batch process the entries in"   << endl;
+  cout << "     blocks (implied by --threads)" << endl;
+
+  cout << "  --blockSize max entries in a block"<< endl;
+  cout << "     handed to a thread. Default: 2000" << endl;
+
+  cout << "  --legacyOR use the MultiLep"       << endl;
+  cout << "     overlap removal functions"     << endl;
+
+  cout << "  --validateOR compare each overlap"<< endl;
+  cout << "     removal to the MultiLep one,"  << endl;
+  cout << "     abort if they differ"          << endl;
+
+  cout << "  --fullSysSel reselect all the"    << endl;
+  cout << "     objects for each systematic"   << endl;
+
+  cout << "  --validateSysSel compare each"    << endl;
+  cout << "     systematic reselection to the" << endl;
+  cout << "     full one, abort if they differ"<< endl;
+
+  cout << "  --progress entries between two"  << endl;
+  cout << "     progress reports. Default: 5000"<< endl;
+
+  cout << "  --checkpoint save the output every" << endl;
+  cout << "     N entries. Default: 0 (off)"    << endl;
+
+  cout << "  --deadline stop cleanly after N"   << endl;
+  cout << "     seconds. Default: 0 (off)."     << endl;
+  cout << "     Not with --threads or --batch"    << endl;
+
+  cout << "  --samples job manifest, one sample"<< endl;
+  cout << "     per line with its own -s, -f, -w,"<< endl;
+  cout << "     -x, --errXsec, -p, --af2 and -o"  << endl;
+  cout << "     (output file). The samples run"   << endl;
+  cout << "     one after the other, reusing the" << endl;
+  cout << "     tools when their setup matches"  << endl;
+
+  cout << "  --resume continue the job from the"<< endl;
+  cout << "     last entry saved in susyNt.root"<< endl;
+
   cout << "  -h print this help"                << endl;
 }
 
 
+/*--------------------------------------------------------------------------------*/
+// Print the merged object and event counters
+/*--------------------------------------------------------------------------------*/
+void printCounters(TH1* h)
+{
+  cout << endl;
+  cout << "Merged counters" << endl;
+  for(int bin=1; bin<=h->GetNbinsX(); bin++){
+    cout << "  " << left << setw(10) << h->GetXaxis()->GetBinLabel(bin) << right
+         << (Long64_t) h->GetBinContent(bin) << endl;
+  }
+  cout << endl;
+}
+
+/*--------------------------------------------------------------------------------*/
+// Merge the outputs in job order so that the entry order is kept
+/*--------------------------------------------------------------------------------*/
+int mergeOutputs(const vector<string>& outFiles)
+{
+  TFileMerger merger(kFALSE);
+  merger.OutputFile("susyNt.root", "RECREATE");
+  for(uint iJob=0; iJob<outFiles.size(); iJob++) merger.AddFile(outFiles[iJob].c_str());
+  if(!merger.Merge()){
+    cout << "NtMaker ERROR - merging of the job outputs failed" << endl;
+    return 1;
+  }
+  cout << "Job outputs merged into susyNt.root" << endl;
+  for(uint iJob=0; iJob<outFiles.size(); iJob++) gSystem->Unlink(outFiles[iJob].c_str());
+
+  TFile* file = TFile::Open("susyNt.root");
+  TH1* counters = file? (TH1*) file->Get("counters") : 0;
+  if(counters) printCounters(counters);
+  if(file) file->Close();
+
+  return 0;
+}
+
+/*--------------------------------------------------------------------------------*/
+// Merge the outputs of the threads, committing the saved events block by block in
+// entry order. The histograms (cutflows and counters) of all the outputs are summed.
+/*--------------------------------------------------------------------------------*/
+int mergeBlockOutputs(const vector<string>& outFiles,
+                      const vector<SusyThreadedLooper::Block>& blocks)
+{
+  vector<TFile*> files;
+  vector<TTree*> trees;
+  for(uint iThread=0; iThread<outFiles.size(); iThread++){
+    TFile* file = TFile::Open(outFiles[iThread].c_str());
+    TTree* tree = file? (TTree*) file->Get("susyNt") : 0;
+    if(!tree){
+      cout << "NtMaker ERROR - no susyNt tree in " << outFiles[iThread] << endl;
+      return 1;
+    }
+    files.push_back(file);
+    trees.push_back(tree);
+  }
+
+  TFile* outFile = new TFile("susyNt.root", "RECREATE");
+  if(outFile->IsZombie()){
+    cout << "NtMaker ERROR - cannot create susyNt.root" << endl;
+    return 1;
+  }
+
+  // All the thread trees read into the buffers of the output tree
+  TTree* outTree = trees[0]->CloneTree(0);
+  for(uint iThread=1; iThread<trees.size(); iThread++) outTree->CopyAddresses(trees[iThread]);
+
+  for(uint iBlock=0; iBlock<blocks.size(); iBlock++){
+    const SusyThreadedLooper::Block& block = blocks[iBlock];
+    if(block.thread < 0) continue;
+    TTree* tree = trees[block.thread];
+    for(Long64_t entry = block.outFirst; entry < block.outFirst + block.outEntries; entry++){
+      tree->GetEntry(entry);
+      outTree->Fill();
+    }
+  }
+
+  // Merge the other objects over the keys of all the outputs, a procCutFlow may only
+  // exist in some of them. The first occurrence is kept and the others are added:
+  // histograms are summed, lastEntry keeps the maximum
+  vector<string> names;
+  map<string, TObject*> objects;
+  for(uint iThread=0; iThread<files.size(); iThread++){
+    TIter next(files[iThread]->GetListOfKeys());
+    while(TKey* key = (TKey*) next()){
+      string name = key->GetName();
+      if(name == "susyNt") continue;
+      TObject* obj = key->ReadObj();
+      map<string, TObject*>::iterator it = objects.find(name);
+      if(it == objects.end()){
+        if(obj->InheritsFrom(TH1::Class())) ((TH1*) obj)->SetDirectory(0);
+        names.push_back(name);
+        objects[name] = obj;
+        continue;
+      }
+      if(obj->InheritsFrom(TH1::Class()) && it->second->InheritsFrom(TH1::Class())){
+        ((TH1*) it->second)->Add((TH1*) obj);
+      }
+      else if(obj->IsA() == TParameter<Long64_t>::Class() && it->second->IsA() == obj->IsA()){
+        TList others;
+        others.Add(obj);
+        ((TParameter<Long64_t>*) it->second)->Merge(&others);
+      }
+      delete obj;
+    }
+  }
+
+  outFile->cd();
+  for(uint iName=0; iName<names.size(); iName++){
+    objects[names[iName]]->Write(names[iName].c_str(), TObject::kOverwrite);
+    delete objects[names[iName]];
+  }
+  outFile->Write(0, TObject::kOverwrite);
+  cout << "Thread outputs merged into susyNt.root, " << outTree->GetEntries() << " entries" << endl;
+
+  TH1* counters = (TH1*) outFile->Get("counters");
+  if(counters) printCounters(counters);
+  outFile->Close();
+  for(uint iThread=0; iThread<files.size(); iThread++){
+    files[iThread]->Close();
+    gSystem->Unlink(outFiles[iThread].c_str());
+  }
+
+  return 0;
+}
+
+/*--------------------------------------------------------------------------------*/
+// Settings of one sample of a job manifest
+/*--------------------------------------------------------------------------------*/
+struct SampleConfig
+{
+  string    sample;
+  string    fileList;
+  float     sumw;
+  float     xsec;
+  float     errXsec;
+  TString   mcProd;
+  bool      isAF2;
+  string    outFile;
+};
+
+/*--------------------------------------------------------------------------------*/
+// Read a job manifest. Each line holds the options of one sample, using the same
+// flags as the command line. Empty lines and lines starting with '#' are skipped.
+/*--------------------------------------------------------------------------------*/
+int readSamples(string fileName, const SampleConfig& defaults, vector<SampleConfig>& configs)
+{
+  ifstream in(fileName.c_str());
+  if(!in.is_open()){
+    cout << "NtMaker ERROR - cannot open job manifest " << fileName << endl;
+    return 1;
+  }
+  string line;
+  int lineNumber = 0;
+  while(getline(in, line)){
+    lineNumber++;
+    stringstream stream(line);
+    vector<string> args;
+    string arg;
+    while(stream >> arg) args.push_back(arg);
+    if(args.size() == 0 || args[0][0] == '#') continue;
+
+    SampleConfig config = defaults;
+    for(uint i = 0; i < args.size(); i++){
+      bool hasValue = i+1 < args.size();
+      if (args[i] == "-s" && hasValue)
+        config.sample = args[++i];
+      else if (args[i] == "-f" && hasValue)
+        config.fileList = args[++i];
+      else if (args[i] == "-w" && hasValue)
+        config.sumw = atof(args[++i].c_str());
+      else if (args[i] == "-x" && hasValue)
+        config.xsec = atof(args[++i].c_str());
+      else if (args[i] == "--errXsec" && hasValue)
+        config.errXsec = atof(args[++i].c_str());
+      else if (args[i] == "-p" && hasValue)
+        config.mcProd = args[++i];
+      else if (args[i] == "--af2")
+        config.isAF2 = true;
+      else if (args[i] == "-o" && hasValue)
+        config.outFile = args[++i];
+      else{
+        cout << "NtMaker ERROR - bad option " << args[i] << " in " << fileName
+             << " line " << lineNumber << endl;
+        return 1;
+      }
+    }
+    if(config.outFile == "") config.outFile = "susyNt_" + config.sample + ".root";
+    configs.push_back(config);
+  }
+  cout << "Job manifest " << fileName << " with " << configs.size() << " samples" << endl;
+  return 0;
+}
+
+/*--------------------------------------------------------------------------------*/
+// Process the samples one after the other with the same selector, so that the
+// tools are only setup again when their configuration changes
+/*--------------------------------------------------------------------------------*/
+int runSamples(SusyNtMaker* susyAna, const vector<SampleConfig>& configs,
+               string entryCache, Long64_t nEvt, Long64_t nSkip)
+{
+  int nFailed = 0;
+  for(uint iSample=0; iSample<configs.size(); iSample++){
+    const SampleConfig& config = configs[iSample];
+    cout << endl;
+    cout << "Sample " << iSample+1 << "/" << configs.size() << " : " << config.sample
+         << " from " << config.fileList << " to " << config.outFile << endl;
+
+    TChain* chain = new TChain("susy");
+    if(ChainEntryCache::addFileList(chain, config.fileList, entryCache)){
+      nFailed++;
+      delete chain;
+      continue;
+    }
+    Long64_t nEntries = chain->GetEntries();
+    Long64_t nSampleEvt = nEvt < 0? nEntries : nEvt;
+
+    MCProduction mcProd = MCProd_Unknown;
+    if(config.mcProd.EqualTo("mc12a", TString::kIgnoreCase)) mcProd = MCProd_MC12a;
+    else if(config.mcProd.EqualTo("mc12b", TString::kIgnoreCase)) mcProd = MCProd_MC12b;
+
+    // Begin sets the MC flag from the sample name
+    susyAna->setIsMC(true);
+    susyAna->setSample(config.sample);
+    susyAna->setSumw(config.sumw);
+    susyAna->setXsec(config.xsec);
+    susyAna->setErrXsec(config.errXsec);
+    susyAna->setMCProduction(mcProd);
+    susyAna->setAF2(config.isAF2);
+    susyAna->setOutputFileName(config.outFile);
+    susyAna->setKeepTools(iSample+1 < configs.size());
+    susyAna->progress().setTotal(nSampleEvt);
+
+    cout << "Total entries:   " << nEntries << endl;
+    cout << "Process entries: " << nSampleEvt << endl;
+    chain->Process(susyAna, config.sample.c_str(), nSampleEvt, nSkip);
+    delete chain;
+  }
+
+  cout << endl;
+  cout << "SusyNtMaker job done, " << configs.size() - nFailed << " of "
+       << configs.size() << " samples processed" << endl;
+  return nFailed? 1 : 0;
+}
+
+/*--------------------------------------------------------------------------------*/
+// Run the selector in nJobs forked processes, each on a contiguous range of
+// entries, then merge the outputs (tree, cutflows and counters) into susyNt.root
+/*--------------------------------------------------------------------------------*/
+int runJobs(SusyNtMaker* susyAna, string fileList, string entryCache, string sample,
+            Long64_t nEvt, Long64_t nSkip, int nJobs)
+{
+  vector<pid_t> pids;
+  vector<string> outFiles;
+
+  // Balance the jobs by number of entries, the first jobs absorb the remainder
+  Long64_t first = nSkip;
+  for(int iJob=0; iJob<nJobs; iJob++){
+    Long64_t nJobEvt = nEvt/nJobs + (iJob < nEvt%nJobs? 1 : 0);
+
+    stringstream stream;
+    stream << "susyNt_" << iJob;
+    string outFile = stream.str() + ".root";
+    string logFile = stream.str() + ".log";
+    outFiles.push_back(outFile);
+
+    cout << "Job " << iJob << ": entries " << first << " - " << first+nJobEvt-1
+         << " output " << outFile << " log " << logFile << endl;
+    cout.flush();
+
+    pid_t pid = fork();
+    if(pid < 0){
+      cout << "NtMaker ERROR - fork failed for job " << iJob << endl;
+      return 1;
+    }
+    if(pid == 0){
+      // Worker: own log, own chain, own output
+      freopen(logFile.c_str(), "w", stdout);
+      freopen(logFile.c_str(), "a", stderr);
+      TChain* chain = new TChain("susy");
+      if(ChainEntryCache::addFileList(chain, fileList, entryCache)) exit(1);
+      susyAna->setOutputFileName(outFile);
+      susyAna->progress().setTotal(nJobEvt);
+      chain->Process(susyAna, sample.c_str(), nJobEvt, first);
+      delete chain;
+      fflush(stdout);
+      exit(0);
+    }
+    pids.push_back(pid);
+    first += nJobEvt;
+  }
+
+  // Wait for all the workers
+  int nFailed = 0;
+  for(uint iJob=0; iJob<pids.size(); iJob++){
+    int status = 0;
+    waitpid(pids[iJob], &status, 0);
+    if(!WIFEXITED(status) || WEXITSTATUS(status) != 0){
+      cout << "NtMaker ERROR - job " << iJob << " failed, see susyNt_" << iJob << ".log" << endl;
+      nFailed++;
+    }
+  }
+  if(nFailed) return 1;
+
+  return mergeOutputs(outFiles);
+}
+
+
 int main(int argc, char** argv)
 {
   ROOT::Cintex::Cintex::Enable();
@@ -121,6 +520,9 @@ int main(int argc, char** argv)
   float sumw      = 1;
   string sample   = "";
   string fileList = "fileList.txt";
+  string entryCache = "";
+  string pickFile = "";
+  string indexDir = "";
   TString mcProdStr = "";
   string grl      = "";
   bool sysOn      = false;
@@ -137,6 +539,24 @@ int main(int argc, char** argv)
   uint nLepFilter = 0;
   uint nLepTauFilter = 2;
   bool filterTrig = false;
+  int cacheSize   = 30;
+  int cacheLearn  = 100;
+  bool readAhead  = false;
+  string profileBranches = "";
+  string branchManifest  = "";
+  int nJobs       = 1;
+  int nThreads    = 1;
+  int blockSize   = 2000;
+  bool batch      = false;
+  bool legacyOR   = false;
+  bool validateOR = false;
+  bool fullSysSel = false;
+  bool validateSysSel = false;
+  int progress    = 5000;
+  int checkpoint  = 0;
+  double deadline = 0;
+  bool resume     = false;
+  string samples  = "";
 
   cout << "SusyNtMaker" << endl;
   cout << endl;
@@ -151,6 +571,12 @@ int main(int argc, char** argv)
       dbg = atoi(argv[++i]);
     else if (strcmp(argv[i], "-f") == 0)
       fileList = argv[++i];
+    else if (strcmp(argv[i], "--entryCache") == 0)
+      entryCache = argv[++i];
+    else if (strcmp(argv[i], "--pick") == 0)
+      pickFile = argv[++i];
+    else if (strcmp(argv[i], "--indexDir") == 0)
+      indexDir = argv[++i];
     else if (strcmp(argv[i], "-s") == 0)
       sample = argv[++i];
     else if (strcmp(argv[i], "-p") == 0)
@@ -195,6 +621,42 @@ int main(int argc, char** argv)
       nLepTauFilter = atoi(argv[++i]);
     else if (strcmp(argv[i], "--filterTrig") == 0)
       filterTrig = true;
+    else if (strcmp(argv[i], "--cacheSize") == 0)
+      cacheSize = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--cacheLearn") == 0)
+      cacheLearn = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--readAhead") == 0)
+      readAhead = true;
+    else if (strcmp(argv[i], "--profileBranches") == 0)
+      profileBranches = argv[++i];
+    else if (strcmp(argv[i], "--branchManifest") == 0)
+      branchManifest = argv[++i];
+    else if (strcmp(argv[i], "--jobs") == 0)
+      nJobs = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--threads") == 0)
+      nThreads = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--batch") == 0)
+      batch = true;
+    else if (strcmp(argv[i], "--blockSize") == 0)
+      blockSize = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--legacyOR") == 0)
+      legacyOR = true;
+    else if (strcmp(argv[i], "--validateOR") == 0)
+      validateOR = true;
+    else if (strcmp(argv[i], "--fullSysSel") == 0)
+      fullSysSel = true;
+    else if (strcmp(argv[i], "--validateSysSel") == 0)
+      validateSysSel = true;
+    else if (strcmp(argv[i], "--progress") == 0)
+      progress = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--checkpoint") == 0)
+      checkpoint = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--deadline") == 0)
+      deadline = atof(argv[++i]);
+    else if (strcmp(argv[i], "--resume") == 0)
+      resume = true;
+    else if (strcmp(argv[i], "--samples") == 0)
+      samples = argv[++i];
     else
     {
       help();
@@ -209,6 +671,9 @@ int main(int argc, char** argv)
   cout << "  nSkip         " << nSkip    << endl;
   cout << "  dbg           " << dbg      << endl;
   cout << "  input         " << fileList << endl;
+  cout << "  entryCache    " << entryCache << endl;
+  cout << "  pick          " << pickFile   << endl;
+  cout << "  indexDir      " << indexDir   << endl;
   cout << "  sumw          " << sumw     << endl;
   cout << "  grl           " << grl      << endl;
   cout << "  sys           " << sysOn    << endl;
@@ -226,53 +691,215 @@ int main(int argc, char** argv)
   cout << "  nLepFilter    " << nLepFilter    << endl;
   cout << "  nLepTauFilter " << nLepTauFilter << endl;
   cout << "  filterTrig    " << filterTrig    << endl;
+  cout << "  cacheSize     " << cacheSize     << endl;
+  cout << "  cacheLearn    " << cacheLearn    << endl;
+  cout << "  readAhead     " << readAhead     << endl;
+  cout << "  profileBranch " << profileBranches << endl;
+  cout << "  branchManif   " << branchManifest  << endl;
+  cout << "  jobs          " << nJobs         << endl;
+  cout << "  threads       " << nThreads      << endl;
+  cout << "  batch         " << batch         << endl;
+  cout << "  blockSize     " << blockSize     << endl;
+  cout << "  legacyOR      " << legacyOR      << endl;
+  cout << "  validateOR    " << validateOR    << endl;
+  cout << "  fullSysSel    " << fullSysSel    << endl;
+  cout << "  validateSysSel " << validateSysSel << endl;
+  cout << "  progress      " << progress      << endl;
+  cout << "  checkpoint    " << checkpoint    << endl;
+  cout << "  deadline      " << deadline      << endl;
+  cout << "  resume        " << resume        << endl;
+  cout << "  samples       " << samples       << endl;
   cout << endl;
 
-  // Build the input chain
+  // Build the input chain, the samples of a job manifest have their own
   TChain* chain = new TChain("susy");
-  int fileErr = ChainHelper::addFileList(chain, fileList);
-  if(fileErr) return 1;
-  Long64_t nEntries = chain->GetEntries();
-  chain->ls();
-
-  // Build the TSelector
-  SusyNtMaker* susyAna = new SusyNtMaker();
-  susyAna->setDebug(dbg);
-  susyAna->setSample(sample);
-  susyAna->setLumi(lumi);
-  susyAna->setSumw(sumw);
-  susyAna->setSys(sysOn);
-  //susyAna->setSelectPhotons(savePh);
-  susyAna->setSelectTaus(saveTau);
-  susyAna->setSaveContTaus(saveContTau);
-  susyAna->setAF2(isAF2);
-  susyAna->setXsec(xsec);
-  susyAna->setErrXsec(errXsec);
-  susyAna->setFillNt(writeNt);
-  susyAna->setD3PDTag(tag);
-  susyAna->setMetFlavor(metFlav);
-  susyAna->setSelectTruthObjects(saveTruth);
-  //susyAna->setDoMetFix(doMetFix);
-  susyAna->setFilter(filter);
-  susyAna->setNLepFilter(nLepFilter);
-  susyAna->setNLepTauFilter(nLepTauFilter);
-  susyAna->setFilterTrigger(filterTrig);
-
-  // GRL - default is set in SusyD3PDAna::Begin, but now we can override it here
-  susyAna->setGRLFile(grl);
-
-  // MC production campaign
-  MCProduction mcProd = MCProd_Unknown;
-  if(mcProdStr.EqualTo("mc12a", TString::kIgnoreCase)) mcProd = MCProd_MC12a;
-  else if(mcProdStr.EqualTo("mc12b", TString::kIgnoreCase)) mcProd = MCProd_MC12b;
-  susyAna->setMCProduction(mcProd);
+  Long64_t nEntries = 0;
+  if(samples == ""){
+    int fileErr = ChainEntryCache::addFileList(chain, fileList, entryCache);
+    if(fileErr) return 1;
+    nEntries = chain->GetEntries();
+    chain->ls();
+  }
+
+  // Build the TSelectors, one for each thread
+  if(nThreads < 1) nThreads = 1;
+  vector<SusyNtMaker*> susyAnas;
+  for(int iThread=0; iThread<nThreads; iThread++){
+    SusyNtMaker* susyAna = new SusyNtMaker();
+    susyAna->setDebug(dbg);
+    susyAna->setSample(sample);
+    susyAna->setLumi(lumi);
+    susyAna->setSumw(sumw);
+    susyAna->setSys(sysOn);
+    //susyAna->setSelectPhotons(savePh);
+    susyAna->setSelectTaus(saveTau);
+    susyAna->setSaveContTaus(saveContTau);
+    susyAna->setAF2(isAF2);
+    susyAna->setXsec(xsec);
+    susyAna->setErrXsec(errXsec);
+    susyAna->setFillNt(writeNt);
+    susyAna->setD3PDTag(tag);
+    susyAna->setMetFlavor(metFlav);
+    susyAna->setSelectTruthObjects(saveTruth);
+    //susyAna->setDoMetFix(doMetFix);
+    susyAna->setFilter(filter);
+    susyAna->setNLepFilter(nLepFilter);
+    susyAna->setNLepTauFilter(nLepTauFilter);
+    susyAna->setFilterTrigger(filterTrig);
+    susyAna->setCacheSize((Long64_t)cacheSize*1024*1024);
+    susyAna->setCacheLearnEntries(cacheLearn);
+    susyAna->setReadAhead(readAhead);
+    susyAna->setCheckpoint(checkpoint);
+    susyAna->setDeadline(deadline);
+    susyAna->setLegacyOverlapRemoval(legacyOR);
+    susyAna->setValidateOverlapRemoval(validateOR);
+    susyAna->setFullSysReselection(fullSysSel);
+    susyAna->setValidateSysReselection(validateSysSel);
+    susyAna->progress().setInterval(progress);
+    if(profileBranches != "") susyAna->setBranchProfile(profileBranches);
+    if(branchManifest  != "") susyAna->setBranchManifest(branchManifest);
+
+    // GRL - default is set in SusyD3PDAna::Begin, but now we can override it here
+    susyAna->setGRLFile(grl);
+
+    // MC production campaign
+    MCProduction mcProd = MCProd_Unknown;
+    if(mcProdStr.EqualTo("mc12a", TString::kIgnoreCase)) mcProd = MCProd_MC12a;
+    else if(mcProdStr.EqualTo("mc12b", TString::kIgnoreCase)) mcProd = MCProd_MC12b;
+    susyAna->setMCProduction(mcProd);
+
+    susyAnas.push_back(susyAna);
+  }
+  SusyNtMaker* susyAna = susyAnas[0];
+
+  // Several samples in this process, the command line gives the defaults
+  if(samples != ""){
+    if(nJobs > 1 || nThreads > 1 || batch || resume || pickFile != ""){
+      cout << "NtMaker ERROR - --samples runs a single job, without --jobs, --threads, --batch, --resume or --pick" << endl;
+      return 1;
+    }
+    SampleConfig defaults;
+    defaults.sample   = sample;
+    defaults.fileList = fileList;
+    defaults.sumw     = sumw;
+    defaults.xsec     = xsec;
+    defaults.errXsec  = errXsec;
+    defaults.mcProd   = mcProdStr;
+    defaults.isAF2    = isAF2;
+    defaults.outFile  = "";
+    vector<SampleConfig> sampleConfigs;
+    if(readSamples(samples, defaults, sampleConfigs)) return 1;
+    int sampleErr = runSamples(susyAna, sampleConfigs, entryCache, nEvt, nSkip);
+    delete chain;
+    return sampleErr;
+  }
+
+  // Only process the picked events, the chain jumps to their entries
+  if(pickFile != ""){
+    if(nJobs > 1 || nThreads > 1 || batch || resume){
+      cout << "NtMaker ERROR - --pick runs a single job, without --jobs, --threads, --batch or --resume" << endl;
+      return 1;
+    }
+    SusyEventIndex eventIndex(indexDir);
+    TEventList* pickList = eventIndex.pickEntries(chain, pickFile);
+    if(pickList == 0) return 1;
+    chain->SetEventList(pickList);
+    nEvt  = pickList->GetN();
+    nSkip = 0;
+  }
 
   // Run the job
   if(nEvt<0) nEvt = nEntries;
   cout << endl;
   cout << "Total entries:   " << nEntries << endl;
   cout << "Process entries: " << nEvt << endl;
-  chain->Process(susyAna, sample.c_str(), nEvt, nSkip);
+  if(nJobs > 1 && nThreads > 1){
+    cout << "NtMaker ERROR - use either --jobs or --threads" << endl;
+    return 1;
+  }
+  // A stopped threaded job can not be resumed, its blocks are not contiguous
+  if(deadline > 0 && (nThreads > 1 || batch)){
+    cout << "NtMaker ERROR - --deadline needs a single job without --threads or --batch" << endl;
+    return 1;
+  }
+  if(resume && (nJobs > 1 || nThreads > 1 || batch || !writeNt)){
+    cout << "NtMaker ERROR - --resume needs a single job writing the output ntuple" << endl;
+    return 1;
+  }
+  if(nJobs > 1){
+    if(!writeNt){
+      cout << "NtMaker ERROR - running several jobs requires writing the output ntuple" << endl;
+      return 1;
+    }
+    if(nSkip + nEvt > nEntries) nEvt = nEntries - nSkip;
+    int jobErr = runJobs(susyAna, fileList, entryCache, sample, nEvt, nSkip, nJobs);
+    if(jobErr) return jobErr;
+  }
+  else if(nThreads > 1 || batch){
+    if(nThreads > 1 && !writeNt){
+      cout << "NtMaker ERROR - running several threads requires writing the output ntuple" << endl;
+      return 1;
+    }
+    if(nSkip + nEvt > nEntries) nEvt = nEntries - nSkip;
+
+    // The first selector owns the pileup, GRL, xsec and SF tools, the others share them
+    SusyThreadedLooper looper("susy", fileList);
+    looper.setDebug(dbg);
+    looper.setEntryCache(entryCache);
+    looper.setBlockSize(blockSize);
+    vector<string> outFiles;
+    for(int iThread=0; iThread<nThreads; iThread++){
+      // A single thread writes susyNt.root directly, in entry order
+      if(nThreads > 1){
+        stringstream stream;
+        stream << "susyNt_t" << iThread << ".root";
+        outFiles.push_back(stream.str());
+        susyAnas[iThread]->setOutputFileName(stream.str());
+      }
+      if(iThread > 0) susyAnas[iThread]->setToolOwner(susyAna);
+      if(iThread > 0) susyAnas[iThread]->setBranchProfileOwner(susyAna);
+      // The blocks are shared out dynamically, so this is only an estimate
+      susyAnas[iThread]->progress().setTotal(nEvt / nThreads);
+      looper.addSelector(susyAnas[iThread]);
+    }
+    if(looper.run(nEvt, nSkip)) return 1;
+    if(nThreads > 1){
+      int mergeErr = mergeBlockOutputs(outFiles, looper.getBlocks());
+      if(mergeErr) return mergeErr;
+    }
+  }
+  else if(resume){
+    // Continue after the last entry saved in susyNt.root, then merge both parts
+    Long64_t lastEntry = SusyNtMaker::readLastEntry("susyNt.root");
+    if(lastEntry < 0){
+      cout << "NtMaker ERROR - no checkpoint found in susyNt.root" << endl;
+      return 1;
+    }
+    Long64_t nDone = lastEntry + 1 - nSkip;
+    cout << "Resuming after entry " << lastEntry << ", " << nDone << " entries already done" << endl;
+    if(nDone >= nEvt){
+      cout << "Nothing left to process" << endl;
+      return 0;
+    }
+    gSystem->Rename("susyNt.root", "susyNt_checkpoint.root");
+    susyAna->setOutputFileName("susyNt_resume.root");
+    susyAna->progress().setTotal(nEvt - nDone);
+    chain->Process(susyAna, sample.c_str(), nEvt - nDone, lastEntry + 1);
+
+    vector<string> outFiles;
+    outFiles.push_back("susyNt_checkpoint.root");
+    outFiles.push_back("susyNt_resume.root");
+    int mergeErr = mergeOutputs(outFiles);
+    if(mergeErr) return mergeErr;
+  }
+  else{
+    susyAna->progress().setTotal(nEvt);
+    chain->Process(susyAna, sample.c_str(), nEvt, nSkip);
+  }
+
+  if(susyAna->GetAbort() != TSelector::kContinue){
+    cout << "Job stopped before the end, continue it with --resume" << endl;
+  }
 
   cout << endl;
   cout << "SusyNtMaker job done" << endl;
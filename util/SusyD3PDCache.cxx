@@ -0,0 +1,165 @@
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "TChain.h"
+#include "TFile.h"
+#include "Cintex/Cintex.h"
+
+#include "SusyCommon/SusyD3PDInterface.h"
+#include "SusyNtuple/ChainHelper.h"
+
+using namespace std;
+
+/*
+
+    SusyD3PDCache - an executable for writing a local cache of the SUSY D3PD
+    branches which are actually used, e.g. by SusyNtMaker.
+
+    The branch list is a manifest written by NtMaker --profileBranches.
+    The cache is written uncompressed by default, so that repeated NtMaker passes
+    over the same sample read it without paying for decompression. It keeps the
+    D3PD tree and branch names, so it can be given to NtMaker as any other input.
+
+*/
+
+void help()
+{
+  cout << "  Options:"                          << endl;
+  cout << "  -n number of events to process"    << endl;
+  cout << "     defaults: -1 (all events)"      << endl;
+
+  cout << "  -k number of events to skip"       << endl;
+  cout << "     defaults: 0"                    << endl;
+
+  cout << "  -f name of input filelist"         << endl;
+  cout << "     defaults: fileList.txt"         << endl;
+
+  cout << "  -o name of output cache file"      << endl;
+  cout << "     defaults: susyD3PDCache.root"   << endl;
+
+  cout << "  --branchManifest branch list, as"  << endl;
+  cout << "     written by NtMaker --profileBranches" << endl;
+  cout << "     this arg is required"           << endl;
+
+  cout << "  --compress compression level"      << endl;
+  cout << "     default: 0 (uncompressed)"      << endl;
+
+  cout << "  -h print this help"                << endl;
+}
+
+
+int main(int argc, char** argv)
+{
+  ROOT::Cintex::Cintex::Enable();
+
+  int nEvt        = -1;
+  int nSkip       = 0;
+  string fileList = "fileList.txt";
+  string outFile  = "susyD3PDCache.root";
+  string manifest = "";
+  int compress    = 0;
+
+  cout << "SusyD3PDCache" << endl;
+  cout << endl;
+
+  // Read inputs to program
+  for(int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-n") == 0)
+      nEvt = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-k") == 0)
+      nSkip = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-f") == 0)
+      fileList = argv[++i];
+    else if (strcmp(argv[i], "-o") == 0)
+      outFile = argv[++i];
+    else if (strcmp(argv[i], "--branchManifest") == 0)
+      manifest = argv[++i];
+    else if (strcmp(argv[i], "--compress") == 0)
+      compress = atoi(argv[++i]);
+    else
+    {
+      help();
+      return 0;
+    }
+  }
+
+  cout << "flags:" << endl;
+  cout << "  nEvt     " << nEvt     << endl;
+  cout << "  nSkip    " << nSkip    << endl;
+  cout << "  input    " << fileList << endl;
+  cout << "  output   " << outFile  << endl;
+  cout << "  manifest " << manifest << endl;
+  cout << "  compress " << compress << endl;
+  cout << endl;
+
+  if(manifest == ""){
+    cout << "SusyD3PDCache ERROR - a branch manifest is required" << endl;
+    help();
+    return 1;
+  }
+  vector<string> branches;
+  if(!SusyD3PDInterface::readBranchManifest(manifest, branches)){
+    cout << "SusyD3PDCache ERROR - cannot read " << manifest << endl;
+    return 1;
+  }
+
+  // Build the input chain
+  TChain* chain = new TChain("susy");
+  int fileErr = ChainHelper::addFileList(chain, fileList);
+  if(fileErr) return 1;
+  Long64_t nEntries = chain->GetEntries();
+  chain->ls();
+
+  // Only the branches of the manifest are copied
+  chain->SetBranchStatus("*", 0);
+  uint nEnabled = 0;
+  for(uint i=0; i<branches.size(); i++){
+    if(chain->GetBranch(branches[i].c_str()) == 0){
+      cout << "SusyD3PDCache WARNING - branch " << branches[i] << " not found in input" << endl;
+      continue;
+    }
+    chain->SetBranchStatus(branches[i].c_str(), 1);
+    nEnabled++;
+  }
+
+  // Build the meta data chain
+  TChain* metaChain = new TChain("susyMeta/CutFlowTree");
+  fileErr = ChainHelper::addFileList(metaChain, fileList);
+  if(fileErr) return 1;
+
+  if(nEvt<0) nEvt = nEntries;
+  cout << endl;
+  cout << "Total entries:   " << nEntries << endl;
+  cout << "Cache entries:   " << nEvt << endl;
+  cout << "Cache branches:  " << nEnabled << endl;
+
+  // Copy the events. The baskets are rewritten with the output compression level.
+  TFile* file = new TFile(outFile.c_str(), "recreate", "SusyD3PD cache", compress);
+  TTree* cache = chain->CopyTree("", "", nEvt, nSkip);
+  if(cache == 0){
+    cout << "SusyD3PDCache ERROR - copying the input failed" << endl;
+    return 1;
+  }
+  file = cache->GetCurrentFile();
+  file->cd();
+  cache->Write(0, TObject::kOverwrite);
+
+  // Keep the meta data so that the cache is a valid D3PD input
+  if(metaChain->GetEntries() > 0){
+    file->mkdir("susyMeta")->cd();
+    TTree* metaTree = metaChain->CloneTree(-1, "fast");
+    if(metaTree) metaTree->Write();
+  }
+
+  cout << "D3PD cache saved to " << file->GetName() << endl;
+  file->Close();
+
+  cout << endl;
+  cout << "SusyD3PDCache job done" << endl;
+
+  delete chain;
+  delete metaChain;
+  return 0;
+}
@@ -8,6 +8,7 @@
 #include "SusyCommon/SusyD3PDAna.h"
 #include "SusyNtuple/SusyDefs.h"
 #include "SusyNtuple/ChainHelper.h"
+#include "SusyCommon/ChainEntryCache.h"
 
 using namespace std;
 
@@ -33,6 +34,10 @@ void help()
   cout << "  -f name of input filelist"         << endl;
   cout << "     defaults: fileList.txt"         << endl;
 
+  cout << "  --entryCache file caching the"     << endl;
+  cout << "     entries of the input files"     << endl;
+  cout << "     default: none (count entries)"  << endl;
+
   cout << "  -s sample name, for naming files"  << endl;
   cout << "     defaults: ntuple sample name"   << endl;
 
@@ -49,6 +54,7 @@ int main(int argc, char** argv)
   int dbg = 0;
   string sample;
   string fileList = "fileList.txt";
+  string entryCache = "";
   
   cout << "SusyD3PDTest" << endl;
   cout << endl;
@@ -63,6 +69,8 @@ int main(int argc, char** argv)
       dbg = atoi(argv[++i]);
     else if (strcmp(argv[i], "-f") == 0)
       fileList = argv[++i];
+    else if (strcmp(argv[i], "--entryCache") == 0)
+      entryCache = argv[++i];
     else if (strcmp(argv[i], "-s") == 0)
       sample = argv[++i];
     //if (strcmp(argv[i], "-h") == 0)
@@ -79,11 +87,12 @@ int main(int argc, char** argv)
   cout << "  nSkip   " << nSkip    << endl;
   cout << "  dbg     " << dbg      << endl;
   cout << "  input   " << fileList << endl;
+  cout << "  entryCache " << entryCache << endl;
   cout << endl;
 
   // Build the input chain
   TChain* chain = new TChain("susy");
-  int fileErr = ChainHelper::addFileList(chain, fileList);
+  int fileErr = ChainEntryCache::addFileList(chain, fileList, entryCache);
   if(fileErr) return 1;
   Long64_t nEntries = chain->GetEntries();
   chain->ls();
@@ -98,6 +107,7 @@ int main(int argc, char** argv)
   cout << endl;
   cout << "Total entries:   " << nEntries << endl;
   cout << "Process entries: " << nEvt << endl;
+  susyAna->progress().setTotal(nEvt);
   chain->Process(susyAna, sample.c_str(), nEvt, nSkip);
 
   cout << endl;
@@ -9,6 +9,7 @@
 #include "SusyCommon/SusyMetValidation.h"
 #include "SusyNtuple/SusyDefs.h"
 #include "SusyNtuple/ChainHelper.h"
+#include "SusyCommon/ChainEntryCache.h"
 
 using namespace std;
 
@@ -34,6 +35,10 @@ void help()
   cout << "  -f name of input filelist"         << endl;
   cout << "     defaults: fileList.txt"         << endl;
 
+  cout << "  --entryCache file caching the"     << endl;
+  cout << "     entries of the input files"     << endl;
+  cout << "     default: none (count entries)"  << endl;
+
   cout << "  -o name of output hist file"       << endl;
   cout << "     defaults: ''"                   << endl;
 
@@ -68,6 +73,7 @@ int main(int argc, char** argv)
   int dbg         = 0;
   string sample;
   string fileList = "fileList.txt";
+  string entryCache = "";
   float xsec      = -1;
   float sumw      = 1;
   bool isAF2      = false;
@@ -87,6 +93,8 @@ int main(int argc, char** argv)
       dbg = atoi(argv[++i]);
     else if (strcmp(argv[i], "-f") == 0)
       fileList = argv[++i];
+    else if (strcmp(argv[i], "--entryCache") == 0)
+      entryCache = argv[++i];
     else if (strcmp(argv[i], "-o") == 0)
       histFileName = argv[++i];
     else if (strcmp(argv[i], "-s") == 0)
@@ -113,6 +121,7 @@ int main(int argc, char** argv)
   cout << "  nSkip   " << nSkip    << endl;
   cout << "  dbg     " << dbg      << endl;
   cout << "  input   " << fileList << endl;
+  cout << "  entryCache " << entryCache << endl;
   cout << "  sumw    " << sumw     << endl;
   cout << "  xsec    " << xsec     << endl;
   cout << "  isAF2   " << isAF2    << endl;
@@ -121,7 +130,7 @@ int main(int argc, char** argv)
 
   // Build the input chain
   TChain* chain = new TChain("susy");
-  int fileErr = ChainHelper::addFileList(chain, fileList);
+  int fileErr = ChainEntryCache::addFileList(chain, fileList, entryCache);
   if(fileErr) return 1;
   Long64_t nEntries = chain->GetEntries();
   chain->ls();
@@ -151,6 +160,7 @@ int main(int argc, char** argv)
   cout << endl;
   cout << "Total entries:   " << nEntries << endl;
   cout << "Process entries: " << nEvt << endl;
+  susyAna->progress().setTotal(nEvt);
   chain->Process(susyAna, sample.c_str(), nEvt, nSkip);
 
   cout << endl;